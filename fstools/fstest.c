@@ -0,0 +1,659 @@
+/*
+ * fstest - run the kernel's file system code on the host against an image
+ *
+ * usage: fstest [-b] [-n <rounds>] [image]
+ *
+ * fs.c, the block layer, the vfs and the string routines of lib.c are built
+ * for the host with the kernel's compiler flags and linked with this program,
+ * see the Makefile. It mounts the image the way fs_init does at boot and checks
+ * read_dentry_by_name, read_dentry_by_index, read_data and dir_read against its
+ * own reading of the image, then memcpy, memmove, memset, strncmp and strlen
+ * against byte loops, and kmalloc, kfree and the arenas of slab.c against the
+ * pages they take. The exit status is 1 if a check failed.
+ *
+ *   -b  time the same functions after the checks
+ *   -n  rounds of every benchmark, 200 by default
+ *
+ * The image is ../student-distrib/filesys_img by default. Images built by
+ * createfs and by mkimg, subdirectories included, are understood.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BLOCK_SIZE 4096
+#define ENTRY_SIZE 64
+#define FNAME_SIZE 32
+
+#define DIR_FILE 1
+#define REG_FILE 2
+
+/* inode layout, as in the kernel's fs.h */
+#define INODE_DIRECT_BLOCKS (BLOCK_SIZE / 4 - 3)
+#define INODE_INDIRECT (BLOCK_SIZE / 4 - 2)
+#define INODE_DINDIRECT (BLOCK_SIZE / 4 - 1)
+#define INDIRECT_ENTRIES (BLOCK_SIZE / 4)
+
+/* slab layout, as in the kernel's slab.h */
+#define SLAB_HEADER 8
+#define KMALLOC_MIN_SIZE 16
+#define KMALLOC_MAX_SIZE 1024
+#define ARENA_ALIGN 8
+
+#define MAX_DEPTH 8
+#define MAX_PATH 300
+#define MAX_FILES 4096
+
+struct dentry {
+	uint8_t fname[FNAME_SIZE];
+	uint32_t type;
+	uint32_t inode;
+	uint8_t reserved[24];
+};
+
+struct arena {
+	uint8_t *page;
+	uint32_t used;
+};
+
+/* a file of the image found by the reference walk */
+struct file {
+	char path[MAX_PATH];
+	uint32_t type;
+	uint32_t inode;
+};
+
+/* the kernel, with host types. the string functions of <string.h> are the
+ * ones of lib.c, the Makefile links them in place of the C library's */
+struct fd;
+void fstest_mount(uint32_t *image);
+struct fd *fstest_dir_open(const uint8_t *path);
+void fstest_dir_rewind(struct fd *fd);
+void fstest_dir_close(struct fd *fd);
+int32_t read_dentry_by_name(const uint8_t *fname, struct dentry *dentry);
+int32_t read_dentry_by_index(uint32_t index, struct dentry *dentry);
+int32_t read_data(uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t length);
+int32_t dir_read(struct fd *fd, uint8_t *buf, uint32_t nbytes);
+void *kmalloc(uint32_t size);
+void kfree(void *obj);
+void arena_init(struct arena *arena);
+void *arena_alloc(struct arena *arena, uint32_t size);
+void arena_reset(struct arena *arena);
+uint32_t fstest_pages_free(void);
+
+static uint8_t *img;
+static uint32_t img_blocks;
+static uint32_t num_dentries, num_inodes, num_blocks;
+static struct file files[MAX_FILES];
+static uint32_t nfiles;
+static uint32_t failures;
+
+#define CHECK(cond, ...) do {						\
+	if (!(cond)) {							\
+		printf("FAIL %s:%d: ", __FILE__, __LINE__);		\
+		printf(__VA_ARGS__);					\
+		printf("\n");						\
+		failures++;						\
+	}								\
+} while (0)
+
+static void *xmalloc(size_t size)
+{
+	void *p = malloc(size ? size : 1);
+
+	if (p == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 8;
+}
+
+static int load_image(const char *name)
+{
+	FILE *in = fopen(name, "rb");
+	long size;
+
+	if (in == NULL || fseek(in, 0, SEEK_END) != 0 || (size = ftell(in)) < BLOCK_SIZE) {
+		fprintf(stderr, "cannot read %s\n", name);
+		return -1;
+	}
+	rewind(in);
+
+	/* page aligned like the boot module, and whole blocks */
+	img_blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	img = aligned_alloc(BLOCK_SIZE, (size_t)img_blocks * BLOCK_SIZE);
+	if (img == NULL || fread(img, 1, size, in) != (size_t)size) {
+		fprintf(stderr, "cannot read %s\n", name);
+		return -1;
+	}
+	fclose(in);
+
+	num_dentries = ((uint32_t *)img)[0];
+	num_inodes = ((uint32_t *)img)[1];
+	num_blocks = ((uint32_t *)img)[2];
+	if (num_dentries > BLOCK_SIZE / ENTRY_SIZE - 1 || 1 + num_inodes + num_blocks > img_blocks) {
+		fprintf(stderr, "%s is not a file system image\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+/* the reference reader, straight from the image */
+
+static uint32_t *ref_node(uint32_t inode)
+{
+	return (uint32_t *)(img + (1 + inode) * BLOCK_SIZE);
+}
+
+static uint32_t ref_word(uint32_t block, uint32_t index)
+{
+	return block < num_blocks ? ((uint32_t *)(img + (1 + num_inodes + block) * BLOCK_SIZE))[index] : (uint32_t)-1;
+}
+
+static uint32_t ref_bmap(const uint32_t *node, uint32_t index)
+{
+	if (index < INODE_DIRECT_BLOCKS)
+		return node[index + 1];
+	index -= INODE_DIRECT_BLOCKS;
+	if (index < INDIRECT_ENTRIES)
+		return ref_word(node[INODE_INDIRECT], index);
+	index -= INDIRECT_ENTRIES;
+	return ref_word(ref_word(node[INODE_DINDIRECT], index / INDIRECT_ENTRIES), index % INDIRECT_ENTRIES);
+}
+
+/* what read_data should return: the bytes, or -1 if a block is bad */
+static int32_t ref_read(uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t length)
+{
+	const uint32_t *node;
+	uint32_t i, block;
+
+	if (inode >= num_inodes)
+		return -1;
+	node = ref_node(inode);
+	if (offset >= node[0])
+		return 0;
+	if (length > node[0] - offset)
+		length = node[0] - offset;
+
+	for (i = 0; i < length; i++) {
+		block = ref_bmap(node, (offset + i) / BLOCK_SIZE);
+		if (block >= num_blocks)
+			return -1;
+		buf[i] = img[(1 + num_inodes + block) * BLOCK_SIZE + (offset + i) % BLOCK_SIZE];
+	}
+	return length;
+}
+
+static void name_of(const struct dentry *d, char *name)
+{
+	memcpy(name, d->fname, FNAME_SIZE);
+	name[FNAME_SIZE] = '\0';
+}
+
+static int is_dot(const char *name)
+{
+	return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+/* collect every file below a directory, given as its dentries */
+static void walk(const struct dentry *d, uint32_t count, const char *dir, uint32_t depth)
+{
+	char name[FNAME_SIZE + 1];
+	struct dentry *sub;
+	uint32_t i, j, length;
+	struct file *f;
+
+	for (i = 0; i < count && nfiles < MAX_FILES; i++) {
+		name_of(&d[i], name);
+		if (name[0] == '\0' || is_dot(name))
+			continue;
+		for (j = 0; j < i && strncmp((char *)d[j].fname, name, FNAME_SIZE); j++)
+			;
+		if (j < i)
+			continue;	/* a duplicate name, the first dentry wins */
+
+		f = &files[nfiles++];
+		snprintf(f->path, MAX_PATH, "%s/%s", dir, name);
+		f->type = d[i].type;
+		f->inode = d[i].inode;
+
+		if (d[i].type == DIR_FILE && d[i].inode < num_inodes && depth + 1 < MAX_DEPTH) {
+			length = ref_node(d[i].inode)[0] / ENTRY_SIZE * ENTRY_SIZE;
+			sub = xmalloc(length);
+			if (ref_read(d[i].inode, 0, (uint8_t *)sub, length) == (int32_t)length)
+				walk(sub, length / ENTRY_SIZE, f->path, depth + 1);
+			free(sub);
+		}
+	}
+}
+
+static void test_dentries(void)
+{
+	struct dentry d, by_name, *want;
+	char name[FNAME_SIZE + 1], path[MAX_PATH + 2];
+	uint32_t i;
+
+	for (i = 0; i < num_dentries; i++) {
+		want = (struct dentry *)img + i + 1;
+		memset(&d, 0, sizeof(d));
+		CHECK(read_dentry_by_index(i, &d) == 0, "read_dentry_by_index(%u)", i);
+		CHECK(!strncmp((char *)d.fname, (char *)want->fname, FNAME_SIZE) && d.type == want->type &&
+		      d.inode == want->inode, "dentry %u differs", i);
+	}
+	CHECK(read_dentry_by_index(num_dentries, &d) == -1, "read_dentry_by_index past the end");
+
+	for (i = 0; i < nfiles; i++) {
+		CHECK(read_dentry_by_name((uint8_t *)files[i].path, &by_name) == 0, "lookup of %s", files[i].path);
+		CHECK(by_name.type == files[i].type && by_name.inode == files[i].inode, "wrong dentry for %s", files[i].path);
+		/* without the leading slash, and through "." */
+		CHECK(read_dentry_by_name((uint8_t *)files[i].path + 1, &by_name) == 0 && by_name.inode == files[i].inode,
+		      "relative lookup of %s", files[i].path + 1);
+		strcpy(path, "/.");
+		strcat(path, files[i].path);
+		CHECK(read_dentry_by_name((uint8_t *)path, &by_name) == 0 && by_name.inode == files[i].inode,
+		      "lookup of %s", path);
+		strcpy(path, files[i].path);
+		strcat(path, "_");
+		CHECK(read_dentry_by_name((uint8_t *)path, &by_name) == -1 || strlen(strrchr(path, '/') + 1) > FNAME_SIZE,
+		      "lookup of missing %s", path);
+	}
+
+	CHECK(read_dentry_by_name((uint8_t *)"", &d) == -1, "lookup of the empty name");
+	CHECK(read_dentry_by_name((uint8_t *)"no such file", &d) == -1, "lookup of a missing name");
+	CHECK(read_dentry_by_name((uint8_t *)"/", &d) == 0 && d.type == DIR_FILE, "lookup of /");
+
+	/* names are compared over 32 bytes, a longer request matches on its prefix
+	 * only if the dentry name fills all 32 */
+	for (i = 0; i < num_dentries; i++) {
+		name_of((struct dentry *)img + i + 1, name);
+		if (strlen(name) == FNAME_SIZE) {
+			strcpy(path, name);
+			path[FNAME_SIZE - 1] = '\0';
+			CHECK(read_dentry_by_name((uint8_t *)path, &d) == -1, "lookup of a prefix of %s", name);
+		}
+	}
+}
+
+static void test_read_data(void)
+{
+	uint8_t *got, *want;
+	uint32_t i, k, length, offset, size;
+	int32_t r;
+
+	for (i = 0; i < nfiles; i++) {
+		if (files[i].type != REG_FILE || files[i].inode >= num_inodes)
+			continue;
+		length = ref_node(files[i].inode)[0];
+		if (length > 64u << 20)
+			continue;	/* the reference reader is slow */
+
+		got = xmalloc(length + BLOCK_SIZE);
+		want = xmalloc(length + BLOCK_SIZE);
+		r = ref_read(files[i].inode, 0, want, length + 100);
+		CHECK(read_data(files[i].inode, 0, got, length + 100) == r, "read_data of all of %s", files[i].path);
+		CHECK(r <= 0 || !memcmp(got, want, r), "data of %s", files[i].path);
+		CHECK(read_data(files[i].inode, length, got, 10) == 0, "read_data at the end of %s", files[i].path);
+
+		for (k = 0; k < 50 && length; k++) {
+			offset = next_rand() % length;
+			size = next_rand() % (3 * BLOCK_SIZE);
+			r = ref_read(files[i].inode, offset, want, size);
+			CHECK(read_data(files[i].inode, offset, got, size) == r, "read_data(%s, %u, %u)", files[i].path, offset, size);
+			CHECK(r <= 0 || !memcmp(got, want, r), "data of %s at %u", files[i].path, offset);
+		}
+		free(got);
+		free(want);
+	}
+
+	CHECK(read_data(num_inodes, 0, (uint8_t *)&r, 1) == -1, "read_data of an invalid inode");
+}
+
+/* list a directory with dir_read and compare with its dentries */
+static void test_dir(const char *path, const struct dentry *d, uint32_t count)
+{
+	char name[FNAME_SIZE + 1];
+	uint8_t buf[FNAME_SIZE];
+	uint32_t i;
+	struct fd *fd;
+	int32_t r;
+
+	fd = fstest_dir_open((const uint8_t *)path);
+	CHECK(fd != NULL, "dir_open of %s", path);
+	if (fd == NULL)
+		return;
+
+	for (i = 0; i < count; i++) {
+		name_of(&d[i], name);
+		r = dir_read(fd, buf, FNAME_SIZE);
+		CHECK(r == (int32_t)strlen(name) && !memcmp(buf, name, r), "entry %u of %s", i, path);
+	}
+	CHECK(dir_read(fd, buf, FNAME_SIZE) == 0, "end of %s", path);
+	fstest_dir_close(fd);
+}
+
+static void test_dirs(void)
+{
+	struct dentry *sub;
+	uint32_t i, length;
+
+	test_dir(".", (struct dentry *)img + 1, num_dentries);
+
+	for (i = 0; i < nfiles; i++) {
+		if (files[i].type != DIR_FILE || files[i].inode >= num_inodes)
+			continue;
+		length = ref_node(files[i].inode)[0] / ENTRY_SIZE * ENTRY_SIZE;
+		sub = xmalloc(length);
+		if (ref_read(files[i].inode, 0, (uint8_t *)sub, length) == (int32_t)length)
+			test_dir(files[i].path, sub, length / ENTRY_SIZE);
+		free(sub);
+	}
+}
+
+static void test_lib(void)
+{
+	static const uint32_t sizes[] = { 0, 1, 2, 3, 4, 5, 7, 8, 15, 16, 31, 33, 64, 100, 4095, 4096, 4097 };
+	static uint8_t src[3 * BLOCK_SIZE], dst[3 * BLOCK_SIZE], want[3 * BLOCK_SIZE];
+	uint32_t i, s, d, n, k;
+	char a[40], b[40];
+
+	for (i = 0; i < sizeof(src); i++)
+		src[i] = next_rand();
+
+	for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+		n = sizes[k];
+		for (s = 0; s < 8; s++) {
+			for (d = 0; d < 8; d++) {
+				for (i = 0; i < sizeof(dst); i++)
+					dst[i] = want[i] = i;
+				for (i = 0; i < n; i++)
+					want[d + i] = src[s + i];
+				CHECK(memcpy(dst + d, src + s, n) == dst + d && !memcmp(dst, want, sizeof(dst)),
+				      "memcpy of %u bytes, offsets %u %u", n, s, d);
+
+				/* overlapping both ways */
+				for (i = 0; i < sizeof(dst); i++)
+					dst[i] = want[i] = src[i];
+				for (i = 0; i < n; i++)
+					want[BLOCK_SIZE + d + i] = src[BLOCK_SIZE + s + i];
+				CHECK(memmove(dst + BLOCK_SIZE + d, dst + BLOCK_SIZE + s, n) == dst + BLOCK_SIZE + d &&
+				      !memcmp(dst, want, sizeof(dst)), "memmove of %u bytes, offsets %u %u", n, s, d);
+			}
+
+			for (i = 0; i < sizeof(dst); i++)
+				dst[i] = want[i] = i;
+			for (i = 0; i < n; i++)
+				want[s + i] = 0xA5;
+			CHECK(memset(dst + s, 0xA5, n) == dst + s && !memcmp(dst, want, sizeof(dst)), "memset of %u bytes at %u", n, s);
+		}
+	}
+
+	for (k = 0; k < 2000; k++) {
+		n = next_rand() % 36;
+		for (i = 0; i < n; i++)
+			a[i] = b[i] = 'a' + next_rand() % 3;
+		a[n] = b[n] = '\0';
+		if (n && (k & 1))
+			b[next_rand() % n] = 'z';
+		d = next_rand() % 40;
+		CHECK(strlen(a) == n, "strlen of %u bytes", n);
+		for (i = 0; i < d && a[i] == b[i] && a[i]; i++)
+			;
+		s = (i == d || (a[i] == b[i])) ? 0 : 1;
+		CHECK((strncmp(a, b, d) != 0) == (int)s, "strncmp(\"%s\", \"%s\", %u)", a, b, d);
+	}
+}
+
+/* objects of n bytes filled with their number, checked nothing wrote over them */
+static void fill_objs(void **objs, uint32_t count, uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		if (objs[i])
+			memset(objs[i], i + 1, n);
+}
+
+static void check_objs(void **objs, uint32_t count, uint32_t n)
+{
+	uint32_t i, k;
+	uint8_t *p;
+
+	for (i = 0; i < count; i++) {
+		p = objs[i];
+		for (k = 0; p && k < n && p[k] == (uint8_t)(i + 1); k++)
+			;
+		CHECK(p && k == n, "object %u of %u bytes overwritten", i, n);
+	}
+}
+
+static void test_slab(void)
+{
+	static void *objs[BLOCK_SIZE / KMALLOC_MIN_SIZE];
+	void *sized[8];
+	struct arena arena;
+	uint32_t i, n, size, pages;
+
+	CHECK(kmalloc(0) == NULL && kmalloc(KMALLOC_MAX_SIZE + 1) == NULL, "kmalloc of 0 or too many bytes");
+
+	/* free objects hold their own link, a page holds all but the header */
+	n = (BLOCK_SIZE - SLAB_HEADER) / KMALLOC_MIN_SIZE;
+	pages = fstest_pages_free();
+	for (i = 0; i < n; i++)
+		objs[i] = kmalloc(KMALLOC_MIN_SIZE);
+	CHECK(fstest_pages_free() == pages - 1, "%u objects of %u bytes took %u pages",
+	      n, KMALLOC_MIN_SIZE, pages - fstest_pages_free());
+	fill_objs(objs, n, KMALLOC_MIN_SIZE);
+	check_objs(objs, n, KMALLOC_MIN_SIZE);
+	for (i = 0; i < n; i++)
+		kfree(objs[i]);
+
+	/* one object of every size, kfree finds each one's cache from the slab
+	 * header and the next kmalloc of that size takes it back */
+	for (i = 0, size = KMALLOC_MIN_SIZE; size <= KMALLOC_MAX_SIZE; i++, size <<= 1) {
+		sized[i] = kmalloc(size);
+		CHECK(sized[i] && ((uintptr_t)sized[i] & (BLOCK_SIZE - 1)) >= SLAB_HEADER, "kmalloc(%u)", size);
+	}
+	n = i;
+	for (i = 0, size = KMALLOC_MIN_SIZE; i < n; i++, size <<= 1) {
+		fill_objs(&sized[i], 1, size);
+		check_objs(&sized[i], 1, size);
+	}
+	pages = fstest_pages_free();
+	for (i = 0; i < n; i += 2)
+		kfree(sized[i]);
+	for (i = 1; i < n; i += 2)
+		kfree(sized[i]);
+	kfree(NULL);
+	for (i = 0, size = KMALLOC_MIN_SIZE; i < n; i++, size <<= 1)
+		CHECK(kmalloc(size / 2 + 1) == sized[i], "kmalloc(%u) did not reuse the object freed from its size", size / 2 + 1);
+	CHECK(fstest_pages_free() == pages, "reused objects took %u pages", pages - fstest_pages_free());
+	for (i = 0; i < n; i++)
+		kfree(sized[i]);
+
+	/* an arena hands out aligned memory page by page and gives every page back */
+	pages = fstest_pages_free();
+	arena_init(&arena);
+	CHECK(arena_alloc(&arena, 0) == NULL && arena_alloc(&arena, BLOCK_SIZE) == NULL, "arena_alloc of 0 bytes or a page");
+	for (i = 0; i < 10; i++) {
+		objs[i] = arena_alloc(&arena, 1000);
+		CHECK(objs[i] && !((uintptr_t)objs[i] & (ARENA_ALIGN - 1)), "arena_alloc(1000) number %u", i);
+	}
+	CHECK(fstest_pages_free() == pages - 3, "10 arena allocations of 1000 bytes took %u pages", pages - fstest_pages_free());
+	fill_objs(objs, 10, 1000);
+	check_objs(objs, 10, 1000);
+	arena_reset(&arena);
+	CHECK(fstest_pages_free() == pages && arena.page == NULL, "arena_reset kept %u pages", pages - fstest_pages_free());
+	CHECK(arena_alloc(&arena, 8) != NULL && fstest_pages_free() == pages - 1, "arena_alloc after arena_reset");
+	arena_reset(&arena);
+}
+
+/* benchmarks */
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *what, double seconds, double ops, double bytes)
+{
+	if (bytes > 0)
+		printf("%-32s %10.1f ns/op %10.1f MB/s\n", what, seconds * 1e9 / ops, bytes / seconds / 1e6);
+	else
+		printf("%-32s %10.1f ns/op\n", what, seconds * 1e9 / ops);
+}
+
+static void bench(uint32_t rounds)
+{
+	static uint8_t a[2 * BLOCK_SIZE], b[2 * BLOCK_SIZE];
+	uint8_t *buf, name[FNAME_SIZE];
+	uint32_t i, r, n, largest = 0, largest_len = 0, total = 0;
+	volatile uint32_t differ = 0;	/* keeps the strncmp calls */
+	double t, bytes;
+	struct dentry d;
+	struct fd *fd;
+
+	for (i = 0; i < nfiles; i++) {
+		if (files[i].type == REG_FILE && files[i].inode < num_inodes && ref_node(files[i].inode)[0] >= largest_len) {
+			largest = i;
+			largest_len = ref_node(files[i].inode)[0];
+		}
+	}
+	buf = xmalloc(largest_len + BLOCK_SIZE);
+
+	t = now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < nfiles; i++)
+			read_dentry_by_name((uint8_t *)files[i].path, &d);
+	report("read_dentry_by_name", now() - t, (double)rounds * nfiles, 0);
+
+	t = now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < nfiles; i++)
+			read_dentry_by_name((uint8_t *)"no such file", &d);
+	report("read_dentry_by_name, missing", now() - t, (double)rounds * nfiles, 0);
+
+	n = 0;
+	bytes = 0;
+	t = now();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < nfiles; i++) {
+			if (files[i].type == REG_FILE && files[i].inode < num_inodes) {
+				bytes += read_data(files[i].inode, 0, buf, largest_len);
+				n++;
+			}
+		}
+	}
+	report("read_data, whole files", now() - t, n, bytes);
+
+	bytes = 0;
+	t = now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < largest_len; i += BLOCK_SIZE)
+			bytes += read_data(files[largest].inode, i, buf, BLOCK_SIZE);
+	report("read_data, 4kB sequential", now() - t, (double)rounds * ((largest_len + BLOCK_SIZE - 1) / BLOCK_SIZE), bytes);
+
+	bytes = 0;
+	t = now();
+	for (r = 0; r < rounds * 64; r++)
+		bytes += read_data(files[largest].inode, largest_len ? next_rand() % largest_len : 0, buf, 512);
+	report("read_data, 512B random", now() - t, (double)rounds * 64, bytes);
+
+	fd = fstest_dir_open((const uint8_t *)".");
+	if (fd != NULL) {
+		t = now();
+		for (r = 0; r < rounds; r++) {
+			fstest_dir_rewind(fd);
+			while (dir_read(fd, name, FNAME_SIZE) > 0)
+				total++;
+		}
+		report("dir_read", now() - t, total ? total : 1, 0);
+		fstest_dir_close(fd);
+	}
+
+	t = now();
+	for (r = 0; r < rounds * 64; r++)
+		memcpy(a, b, BLOCK_SIZE);
+	report("memcpy 4kB aligned", now() - t, (double)rounds * 64, (double)rounds * 64 * BLOCK_SIZE);
+
+	t = now();
+	for (r = 0; r < rounds * 64; r++)
+		memcpy(a + 1, b + 2, BLOCK_SIZE - 3);
+	report("memcpy 4kB unaligned", now() - t, (double)rounds * 64, (double)rounds * 64 * (BLOCK_SIZE - 3));
+
+	t = now();
+	for (r = 0; r < rounds * 64; r++)
+		memmove(a + 1, a, BLOCK_SIZE);
+	report("memmove 4kB overlapping", now() - t, (double)rounds * 64, (double)rounds * 64 * BLOCK_SIZE);
+
+	t = now();
+	for (r = 0; r < rounds * 64; r++)
+		memset(a, r, BLOCK_SIZE);
+	report("memset 4kB", now() - t, (double)rounds * 64, (double)rounds * 64 * BLOCK_SIZE);
+
+	memset(a, 'x', FNAME_SIZE);
+	memset(b, 'x', FNAME_SIZE);
+	t = now();
+	for (r = 0; r < rounds * 1024; r++)
+		differ += strncmp((char *)a, (char *)b, FNAME_SIZE) != 0;
+	report("strncmp 32B equal", now() - t, (double)rounds * 1024, 0);
+
+	free(buf);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-b] [-n <rounds>] [image]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *name = "../student-distrib/filesys_img";
+	uint32_t rounds = 200, benchmark = 0;
+	int i, named = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-b"))
+			benchmark = 1;
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			rounds = strtoul(argv[++i], NULL, 0);
+		else if (argv[i][0] != '-' && !named) {
+			name = argv[i];
+			named = 1;
+		} else
+			usage(argv[0]);
+	}
+	if (rounds == 0)
+		usage(argv[0]);
+
+	if (load_image(name) == -1)
+		return 1;
+	walk((struct dentry *)img + 1, num_dentries, "", 0);
+
+	fstest_mount((uint32_t *)img);
+
+	test_dentries();
+	test_read_data();
+	test_dirs();
+	test_lib();
+	test_slab();
+	printf("%s: %u files, %s (%u failures)\n", name, nfiles, failures ? "FAILED" : "ok", failures);
+
+	if (benchmark)
+		bench(rounds);
+
+	return failures != 0;
+}
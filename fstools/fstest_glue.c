@@ -0,0 +1,95 @@
+/*
+ * fstest_glue.c - the part of fstest built against the kernel's headers
+ *
+ * fstest.c uses the host's headers, so everything that needs the layout of a
+ * kernel structure, an fd_t or the fops tables, is done here.
+ */
+#include "fs.h"
+#include "vfs.h"
+#include "rtc.h"
+
+/* pages for the slab caches and arenas, fstest has no frame allocator. a few
+ * are plenty for the vnodes it opens and the slab checks */
+#define FSTEST_PAGES 16
+static uint8_t fstest_pages[FSTEST_PAGES][PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t fstest_pages_used;
+static void *fstest_page_list;
+
+void *alloc_kernel_page(void)
+{
+	void *page = fstest_page_list;
+
+	if (page)
+		fstest_page_list = *(void **)page;
+	else if (fstest_pages_used < FSTEST_PAGES)
+		page = fstest_pages[fstest_pages_used++];
+	return page;
+}
+
+void free_kernel_page(void *page)
+{
+	if (!page)
+		return;
+	*(void **)page = fstest_page_list;
+	fstest_page_list = page;
+}
+
+/* pages alloc_kernel_page can still give */
+uint32_t fstest_pages_free(void)
+{
+	uint32_t n = FSTEST_PAGES - fstest_pages_used;
+	void *page;
+
+	for (page = fstest_page_list; page; page = *(void **)page)
+		n++;
+	return n;
+}
+
+/* the rtc dentry of an image opens the rtc, which the host does not have */
+int rtc_open(fd_t *file_desc)
+{
+	return -1;
+}
+
+/* mount the image like fs_init at boot, with the fops set_up_fops would give
+ * the file system */
+void fstest_mount(uint32_t *image)
+{
+	file_fops.open = (uint32_t *)file_open;
+	file_fops.read = (read_func)file_read;
+	file_fops.write = (write_func)file_write;
+	file_fops.close = (close_func)file_close;
+
+	dir_fops.open = (uint32_t *)dir_open;
+	dir_fops.read = (read_func)dir_read;
+	dir_fops.write = (write_func)dir_write;
+	dir_fops.close = (close_func)dir_close;
+
+	fs_init(image);
+}
+
+/* open a directory, NULL if it cannot be */
+fd_t *fstest_dir_open(const uint8_t *path)
+{
+	static fd_t fds[FS_MAX_DEPTH + 1];
+	uint32_t i;
+
+	for (i = 0; i <= FS_MAX_DEPTH; i++) {
+		if (fds[i].flags == 0) {
+			memset(&fds[i], 0, sizeof(fd_t));
+			return dir_open(&fds[i], path) == 0 ? &fds[i] : NULL;
+		}
+	}
+	return NULL;
+}
+
+/* start reading a directory over */
+void fstest_dir_rewind(fd_t *file_desc)
+{
+	file_desc->file_pos = 0;
+}
+
+void fstest_dir_close(fd_t *file_desc)
+{
+	vfs_close(file_desc);
+}
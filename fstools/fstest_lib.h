@@ -0,0 +1,21 @@
+/*
+ * lib.h for the host build of fstest. The Makefile copies the kernel's lib.h
+ * next to it as klib.h, so the declarations stay those of the kernel, and only
+ * the interrupt flag macros, which fault outside ring 0, become no-ops.
+ */
+#ifndef _FSTEST_LIB_H
+#define _FSTEST_LIB_H
+
+#include "klib.h"
+
+#undef cli
+#undef sti
+#undef cli_and_save
+#undef restore_flags
+
+#define cli() do { } while (0)
+#define sti() do { } while (0)
+#define cli_and_save(flags) do { (flags) = 0; } while (0)
+#define restore_flags(flags) do { (void)(flags); } while (0)
+
+#endif /* _FSTEST_LIB_H */
@@ -0,0 +1,170 @@
+/*
+ * lzimg - compress a file system image for the kernel
+ *
+ * usage: lzimg <filesys_img> <output>
+ *
+ * Every 4kB block of the image is compressed on its own in the LZ4 block
+ * format, so the kernel can decompress any block when it is read. The output
+ * starts with the magic "LZFS", the number of blocks and num_blocks+1 byte
+ * offsets of the compressed blocks. All zero blocks take no space and blocks
+ * that do not shrink are stored as they are.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_SIZE 4096
+#define LZ_MAGIC 0x53465A4C
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+
+static uint32_t hash4(const uint8_t* p)
+{
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* write a length of 15 or more as 255 bytes and the rest */
+static uint32_t put_length(uint8_t* dst, uint32_t op, uint32_t len)
+{
+	for (len -= 15; len >= 255; len -= 255)
+		dst[op++] = 255;
+	dst[op++] = len;
+	return op;
+}
+
+static uint32_t put_sequence(uint8_t* dst, uint32_t op, const uint8_t* lit,
+                             uint32_t nlit, uint32_t offset, uint32_t mlen)
+{
+	uint32_t token = op++;
+
+	dst[token] = (nlit < 15 ? nlit : 15) << 4;
+	if (nlit >= 15)
+		op = put_length(dst, op, nlit);
+	memcpy(dst + op, lit, nlit);
+	op += nlit;
+
+	if (mlen) {
+		dst[op++] = offset & 0xFF;
+		dst[op++] = offset >> 8;
+		mlen -= LZ_MIN_MATCH;
+		dst[token] |= mlen < 15 ? mlen : 15;
+		if (mlen >= 15)
+			op = put_length(dst, op, mlen);
+	}
+	return op;
+}
+
+/*
+ * greedy compression with a table of the last position of every 4 byte
+ * hash, dst must hold 2 * BLOCK_SIZE bytes
+ */
+static uint32_t compress_block(const uint8_t* src, uint8_t* dst)
+{
+	int32_t table[1 << LZ_HASH_BITS];
+	uint32_t ip = 0, anchor = 0, op = 0;
+	uint32_t h, cand, len;
+
+	memset(table, -1, sizeof(table));
+
+	while (ip + LZ_MIN_MATCH <= BLOCK_SIZE) {
+		h = hash4(src + ip);
+		cand = table[h];
+		table[h] = ip;
+		if (cand == (uint32_t)-1 || ip - cand > 0xFFFF ||
+		    memcmp(src + cand, src + ip, LZ_MIN_MATCH)) {
+			ip++;
+			continue;
+		}
+		for (len = LZ_MIN_MATCH; ip + len < BLOCK_SIZE &&
+		     src[cand + len] == src[ip + len]; len++)
+			;
+		op = put_sequence(dst, op, src + anchor, ip - anchor, ip - cand, len);
+		ip += len;
+		anchor = ip;
+	}
+	if (anchor < BLOCK_SIZE)
+		op = put_sequence(dst, op, src + anchor, BLOCK_SIZE - anchor, 0, 0);
+	return op;
+}
+
+static int all_zero(const uint8_t* p)
+{
+	int i;
+
+	for (i = 0; i < BLOCK_SIZE; i++)
+		if (p[i])
+			return 0;
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	FILE *in, *out;
+	uint8_t *img, *data, tmp[2 * BLOCK_SIZE];
+	uint32_t *hdr, nblocks, i, len, pos, size;
+	long n;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <filesys_img> <output>\n", argv[0]);
+		return 1;
+	}
+	if ((in = fopen(argv[1], "rb")) == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	fseek(in, 0, SEEK_END);
+	n = ftell(in);
+	rewind(in);
+	nblocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if (nblocks == 0) {
+		fprintf(stderr, "%s: empty image\n", argv[1]);
+		return 1;
+	}
+
+	img = calloc(nblocks, BLOCK_SIZE);
+	data = malloc((size_t)nblocks * BLOCK_SIZE);
+	hdr = malloc((nblocks + 3) * sizeof(uint32_t));
+	if (!img || !data || !hdr || fread(img, 1, n, in) != (size_t)n) {
+		fprintf(stderr, "%s: cannot read image\n", argv[1]);
+		return 1;
+	}
+	fclose(in);
+
+	hdr[0] = LZ_MAGIC;
+	hdr[1] = nblocks;
+	pos = 0;
+	for (i = 0; i < nblocks; i++) {
+		hdr[2 + i] = pos;
+		if (all_zero(img + i * BLOCK_SIZE))
+			continue;
+		len = compress_block(img + i * BLOCK_SIZE, tmp);
+		if (len >= BLOCK_SIZE) {
+			memcpy(data + pos, img + i * BLOCK_SIZE, BLOCK_SIZE);
+			pos += BLOCK_SIZE;
+		} else {
+			memcpy(data + pos, tmp, len);
+			pos += len;
+		}
+	}
+	hdr[2 + nblocks] = pos;
+
+	/* offsets are from the start of the image, past the header */
+	size = (nblocks + 3) * sizeof(uint32_t);
+	for (i = 0; i <= nblocks; i++)
+		hdr[2 + i] += size;
+
+	if ((out = fopen(argv[2], "wb")) == NULL) {
+		perror(argv[2]);
+		return 1;
+	}
+	if (fwrite(hdr, 1, size, out) != size || fwrite(data, 1, pos, out) != pos) {
+		fprintf(stderr, "%s: write failed\n", argv[2]);
+		return 1;
+	}
+	fclose(out);
+
+	printf("%u blocks, %ld bytes -> %u bytes\n", nblocks, n, size + pos);
+	return 0;
+}
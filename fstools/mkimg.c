@@ -0,0 +1,591 @@
+/*
+ * mkimg - build a file system image for the kernel from a directory
+ *
+ * usage: mkimg [-s] [-c] [-d] [-r] [-a <order file>] [-n <inodes>]
+ *              [-b <data blocks>] [-S <seed>] [-o <output>] <directory>
+ *
+ * The image has the format createfs writes: a boot block with the counts and
+ * the dentries, the index nodes, then the data blocks. Every regular file of
+ * the directory gets a dentry, plus "." and the "rtc" device. Subdirectories
+ * get a DIR_FILE dentry and an index node whose data is their dentries, the
+ * root directory holds at most 63 entries and a subdirectory any number.
+ * Subdirectories nest at most 8 deep, as far as the kernel resolves. Like createfs,
+ * names are cut to 31 characters and inodes and data blocks are scattered
+ * over the image, with a fixed seed so the same input gives the same image.
+ *
+ *   -s  sort the dentries by name, otherwise they are in readdir order
+ *   -c  number inodes and place data blocks contiguously, file by file in
+ *       access order, so the kernel reads each file as one extent
+ *   -d  store identical data blocks once. the image is flagged so the kernel
+ *       mounts it read only, a write would change every file sharing a block
+ *   -r  print a layout report
+ *   -a  access order for -c, a file with one path per line, like bin/shell.
+ *       files not in it follow in dentry order
+ *   -n  number of index nodes, twice the number of files by default
+ *   -b  number of data blocks, twice the number used by default. the spare
+ *       inodes and blocks are free for files created by the kernel
+ *   -S  seed of the scattered layout
+ *   -o  output file, fs.out by default
+ */
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define BLOCK_SIZE 4096
+#define ENTRY_SIZE 64
+#define FNAME_SIZE 32
+#define MAX_DENTRIES (BLOCK_SIZE / ENTRY_SIZE - 1)
+
+#define RTC_FILE 0
+#define DIR_FILE 1
+#define REG_FILE 2
+
+/* inode layout, as in the kernel's fs.h */
+#define INODE_DIRECT_BLOCKS (BLOCK_SIZE / 4 - 3)
+#define INODE_INDIRECT (BLOCK_SIZE / 4 - 2)
+#define INODE_DINDIRECT (BLOCK_SIZE / 4 - 1)
+#define INDIRECT_ENTRIES (BLOCK_SIZE / 4)
+
+/* subdirectories the kernel resolves a path through, as in the kernel's fs.h */
+#define FS_MAX_DEPTH 8
+
+/* boot block flags, the word after the three counts */
+#define FS_FLAGS_WORD 3
+#define FS_SHARED_BLOCKS 0x1
+
+#define DEDUP_HASH_SIZE 4096
+
+struct file {
+	char name[FNAME_SIZE];
+	char path[256];			/* from the top directory, for -a and the report */
+	uint32_t subdir;		/* 1 for a subdirectory */
+	uint32_t first;			/* dentries of a subdirectory are files[first] */
+	uint32_t count;			/* up to files[first+count-1] */
+	uint32_t type;
+	uint32_t inode;
+	uint8_t *data;
+	uint32_t length;
+	uint32_t nblocks;		/* data blocks of the contents */
+	uint32_t nindirect;		/* indirect blocks mapping them */
+	uint32_t *blocks;		/* data block of every content block */
+	uint32_t *indirect;		/* data block of every indirect block */
+	uint32_t order;			/* position in the access order */
+	uint32_t shared;		/* content blocks stored by another block */
+};
+
+/* a stored data block, for -d */
+struct dedup {
+	uint32_t block;
+	const uint8_t *data;
+	struct dedup *next;
+};
+
+static struct file *files;
+static uint32_t nfiles, max_files, nroot;
+static uint32_t next_block;		/* allocation cursor of the contiguous layout */
+static uint32_t *scatter;		/* free data blocks in random order */
+static const uint8_t **contents;	/* what each data block holds, NULL if zero */
+static struct dedup *dedup_hash[DEDUP_HASH_SIZE];
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s] [-c] [-d] [-r] [-a <order file>] [-n <inodes>]\n"
+		"       [-b <data blocks>] [-S <seed>] [-o <output>] <directory>\n", prog);
+	exit(1);
+}
+
+static void *xcalloc(size_t n, size_t size)
+{
+	void *p = calloc(n ? n : 1, size);
+
+	if (p == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	return p;
+}
+
+/* a small generator of our own so the layout does not depend on the libc */
+static uint32_t rand_state;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245u + 12345u;
+	return rand_state >> 8;
+}
+
+static void shuffle(uint32_t *v, uint32_t n)
+{
+	uint32_t i, j, t;
+
+	for (i = n; i > 1; i--) {
+		j = next_rand() % i;
+		t = v[i - 1];
+		v[i - 1] = v[j];
+		v[j] = t;
+	}
+}
+
+static int cmp_name(const void *a, const void *b)
+{
+	return strncmp(((const struct file *)a)->name,
+		       ((const struct file *)b)->name, FNAME_SIZE);
+}
+
+static int cmp_order(const void *a, const void *b)
+{
+	const struct file *x = *(const struct file * const *)a;
+	const struct file *y = *(const struct file * const *)b;
+
+	return x->order < y->order ? -1 : x->order > y->order;
+}
+
+static struct file *add_entry(const char *name, const char *rel, uint32_t type, int root)
+{
+	struct file *f;
+
+	if (root && nroot == MAX_DENTRIES) {
+		fprintf(stderr, "Could not create an entry for %s, skipping it...\n", name);
+		return NULL;
+	}
+	if (nfiles == max_files) {
+		max_files = max_files ? 2 * max_files : 128;
+		if ((files = realloc(files, max_files * sizeof(*files))) == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	nroot += root;
+	f = &files[nfiles++];
+	memset(f, 0, sizeof(*f));
+	strncpy(f->name, name, FNAME_SIZE - 1);
+	snprintf(f->path, sizeof(f->path), "%s%s%s", rel, *rel ? "/" : "", name);
+	f->type = type;
+	return f;
+}
+
+static void set_length(struct file *f, uint32_t length)
+{
+	f->length = length;
+	f->nblocks = (f->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if (f->nblocks > INODE_DIRECT_BLOCKS)
+		f->nindirect++;
+	if (f->nblocks > INODE_DIRECT_BLOCKS + INDIRECT_ENTRIES) {
+		f->nindirect += 1 + (f->nblocks - INODE_DIRECT_BLOCKS - INDIRECT_ENTRIES
+				     + INDIRECT_ENTRIES - 1) / INDIRECT_ENTRIES;
+	}
+	f->blocks = xcalloc(f->nblocks, sizeof(uint32_t));
+	f->indirect = xcalloc(f->nindirect, sizeof(uint32_t));
+}
+
+static int read_file(struct file *f, const char *path)
+{
+	FILE *in;
+	struct stat st;
+
+	if (stat(path, &st) == -1 || (in = fopen(path, "rb")) == NULL) {
+		perror(path);
+		return -1;
+	}
+	f->data = xcalloc(1, st.st_size);
+	if (fread(f->data, 1, st.st_size, in) != (size_t)st.st_size) {
+		fprintf(stderr, "%s: short read\n", path);
+		fclose(in);
+		return -1;
+	}
+	fclose(in);
+	set_length(f, st.st_size);
+	return 0;
+}
+
+/*
+ * add the entries of a directory, then those of its subdirectories, so the
+ * dentries of every directory are next to each other in files[]. depth is the
+ * number of subdirectories dir is nested in
+ */
+static int scan_dir(const char *dir, const char *rel, int32_t parent, uint32_t depth, int sorted)
+{
+	char path[4096];
+	char sub[sizeof(files->path)];
+	struct dirent *de;
+	struct stat st;
+	struct file *f;
+	uint32_t i, first = nfiles, count;
+	DIR *d;
+
+	if ((d = opendir(dir)) == NULL) {
+		fprintf(stderr, "opendir: Directory %s does not exist\n", dir);
+		return -1;
+	}
+	while ((de = readdir(d)) != NULL) {
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		if (stat(path, &st) == -1)
+			continue;
+		if (S_ISREG(st.st_mode)) {
+			if ((f = add_entry(de->d_name, rel, REG_FILE, parent == -1)) != NULL &&
+			    read_file(f, path) == -1)
+				return -1;
+		} else if (S_ISDIR(st.st_mode)) {
+			if ((f = add_entry(de->d_name, rel, DIR_FILE, parent == -1)) != NULL)
+				f->subdir = 1;
+		}
+	}
+	closedir(d);
+	if (parent == -1)
+		add_entry("rtc", rel, RTC_FILE, 1);
+
+	count = nfiles - first;
+	if (sorted)
+		qsort(files + first, count, sizeof(struct file), cmp_name);
+	if (parent != -1) {
+		files[parent].first = first;
+		files[parent].count = count;
+		set_length(&files[parent], count * ENTRY_SIZE);
+	}
+
+	for (i = first; i < first + count; i++) {
+		if (!files[i].subdir)
+			continue;
+		if (depth == FS_MAX_DEPTH) {
+			fprintf(stderr, "%s: nested deeper than %d directories\n",
+				files[i].path, FS_MAX_DEPTH);
+			return -1;
+		}
+		snprintf(path, sizeof(path), "%s/%s", dir, files[i].name);
+		/* add_entry may move files[], so the path is copied first */
+		strcpy(sub, files[i].path);
+		if (scan_dir(path, sub, i, depth + 1, sorted) == -1)
+			return -1;
+	}
+	return 0;
+}
+
+static void put_dentry(uint8_t *p, const struct file *f)
+{
+	memcpy(p, f->name, FNAME_SIZE);
+	memcpy(p + FNAME_SIZE, &f->type, 4);
+	memcpy(p + FNAME_SIZE + 4, &f->inode, 4);
+}
+
+static int has_inode(const struct file *f)
+{
+	return f->type == REG_FILE || f->subdir;
+}
+
+static void read_order(const char *path)
+{
+	FILE *in;
+	char line[256];
+	uint32_t i, pos = 0;
+	size_t len;
+
+	if ((in = fopen(path, "r")) == NULL) {
+		perror(path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), in) != NULL) {
+		len = strlen(line);
+		while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = '\0';
+		for (i = 0; i < nfiles; i++) {
+			if (files[i].order == (uint32_t)-1 && !strcmp(files[i].path, line)) {
+				files[i].order = pos++;
+				break;
+			}
+		}
+	}
+	fclose(in);
+
+	for (i = 0; i < nfiles; i++)
+		if (files[i].order == (uint32_t)-1)
+			files[i].order = pos++;
+}
+
+static uint32_t alloc_block(int contiguous)
+{
+	return contiguous ? next_block++ : scatter[next_block++];
+}
+
+static uint32_t hash_block(const uint8_t *p)
+{
+	uint32_t h = 2166136261u, i;
+
+	for (i = 0; i < BLOCK_SIZE; i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h % DEDUP_HASH_SIZE;
+}
+
+/* the contents of block i of a file, the last one is zero padded */
+static const uint8_t *file_block(const struct file *f, uint32_t i, uint8_t *tail)
+{
+	uint32_t len = f->length - i * BLOCK_SIZE;
+
+	if (len >= BLOCK_SIZE)
+		return f->data + i * BLOCK_SIZE;
+	memset(tail, 0, BLOCK_SIZE);
+	memcpy(tail, f->data + i * BLOCK_SIZE, len);
+	return tail;
+}
+
+/*
+ * give every block of a file a data block, its indirect blocks come right
+ * before the content blocks they map so a sequential read moves forward
+ */
+static void place_file(struct file *f, int contiguous, int dedup)
+{
+	uint8_t tail[BLOCK_SIZE];
+	const uint8_t *p;
+	struct dedup *d;
+	uint32_t i, ind = 0, h = 0;
+
+	for (i = 0; i < f->nblocks; i++) {
+		if (i == INODE_DIRECT_BLOCKS)
+			f->indirect[ind++] = alloc_block(contiguous);
+		if (i == INODE_DIRECT_BLOCKS + INDIRECT_ENTRIES)
+			f->indirect[ind++] = alloc_block(contiguous);
+		if (i >= INODE_DIRECT_BLOCKS + INDIRECT_ENTRIES &&
+		    (i - INODE_DIRECT_BLOCKS - INDIRECT_ENTRIES) % INDIRECT_ENTRIES == 0)
+			f->indirect[ind++] = alloc_block(contiguous);
+
+		p = file_block(f, i, tail);
+		if (dedup) {
+			h = hash_block(p);
+			for (d = dedup_hash[h]; d != NULL; d = d->next)
+				if (!memcmp(d->data, p, BLOCK_SIZE))
+					break;
+			if (d != NULL) {
+				f->blocks[i] = d->block;
+				f->shared++;
+				continue;
+			}
+		}
+
+		f->blocks[i] = alloc_block(contiguous);
+		if (p == tail) {
+			uint8_t *copy = xcalloc(1, BLOCK_SIZE);
+			memcpy(copy, tail, BLOCK_SIZE);
+			p = copy;
+		}
+		contents[f->blocks[i]] = p;
+		if (dedup) {
+			d = xcalloc(1, sizeof(*d));
+			d->block = f->blocks[i];
+			d->data = p;
+			d->next = dedup_hash[h];
+			dedup_hash[h] = d;
+		}
+	}
+}
+
+/* fill the index node and indirect blocks of a file */
+static void map_file(const struct file *f, uint8_t *img, uint32_t data_start)
+{
+	uint32_t *node = (uint32_t *)(img + (f->inode + 1) * BLOCK_SIZE);
+	uint32_t *ind = NULL, *dind = NULL;
+	uint32_t i, rel, next = 0;
+
+	node[0] = f->length;
+	for (i = 0; i < f->nblocks; i++) {
+		if (i < INODE_DIRECT_BLOCKS) {
+			node[1 + i] = f->blocks[i];
+			continue;
+		}
+		if (i == INODE_DIRECT_BLOCKS) {
+			node[INODE_INDIRECT] = f->indirect[next++];
+			ind = (uint32_t *)(img + (data_start + node[INODE_INDIRECT]) * BLOCK_SIZE);
+		}
+		if (i < INODE_DIRECT_BLOCKS + INDIRECT_ENTRIES) {
+			ind[i - INODE_DIRECT_BLOCKS] = f->blocks[i];
+			continue;
+		}
+		rel = i - INODE_DIRECT_BLOCKS - INDIRECT_ENTRIES;
+		if (rel == 0) {
+			node[INODE_DINDIRECT] = f->indirect[next++];
+			dind = (uint32_t *)(img + (data_start + node[INODE_DINDIRECT]) * BLOCK_SIZE);
+		}
+		if (rel % INDIRECT_ENTRIES == 0) {
+			dind[rel / INDIRECT_ENTRIES] = f->indirect[next++];
+			ind = (uint32_t *)(img + (data_start + dind[rel / INDIRECT_ENTRIES]) * BLOCK_SIZE);
+		}
+		ind[rel % INDIRECT_ENTRIES] = f->blocks[i];
+	}
+}
+
+/* runs of consecutive data blocks in file order */
+static uint32_t count_extents(const struct file *f)
+{
+	uint32_t i, n = f->nblocks ? 1 : 0;
+
+	for (i = 1; i < f->nblocks; i++)
+		if (f->blocks[i] != f->blocks[i - 1] + 1)
+			n++;
+	return n;
+}
+
+static void report(struct file **order, uint32_t ninodes, uint32_t nblocks,
+		   uint32_t used, int dedup)
+{
+	uint32_t i, shared = 0, extents = 0, content = 0;
+	struct file *f;
+
+	printf("%-32s %5s %9s %6s %7s %6s\n", "name", "inode", "length", "blocks", "extents", "shared");
+	for (i = 0; i < nfiles; i++) {
+		f = order[i];
+		if (!has_inode(f)) {
+			printf("%-32s %5s %9s\n", f->path, "-", f->type == DIR_FILE ? "dir" : "rtc");
+			continue;
+		}
+		printf("%-32s %5u %9u %6u %7u %6u\n", f->path, f->inode, f->length,
+		       f->nblocks + f->nindirect, count_extents(f), f->shared);
+		shared += f->shared;
+		extents += count_extents(f);
+		content += f->nblocks;
+	}
+	printf("\n%u dentries, %u of %u inodes, %u of %u data blocks used\n",
+	       nfiles, nfiles - 2, ninodes, used, nblocks);
+	printf("%u content blocks in %u extents", content, extents);
+	if (dedup)
+		printf(", %u stored once for several blocks", shared);
+	printf("\nimage size %u bytes\n", (1 + ninodes + nblocks) * BLOCK_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dir = NULL, *out_name = "fs.out", *order_name = NULL;
+	int sorted = 0, contiguous = 0, dedup = 0, show = 0;
+	uint32_t ninodes = 0, nblocks = 0, seed = 0;
+	uint32_t i, j, needed, used, data_start, *inodes;
+	struct file *f, **order;
+	uint8_t *img, *boot;
+	FILE *out;
+
+	for (i = 1; i < (uint32_t)argc; i++) {
+		if (!strcmp(argv[i], "-s"))
+			sorted = 1;
+		else if (!strcmp(argv[i], "-c"))
+			contiguous = 1;
+		else if (!strcmp(argv[i], "-d"))
+			dedup = 1;
+		else if (!strcmp(argv[i], "-r"))
+			show = 1;
+		else if (!strcmp(argv[i], "-a") && i + 1 < (uint32_t)argc)
+			order_name = argv[++i];
+		else if (!strcmp(argv[i], "-n") && i + 1 < (uint32_t)argc)
+			ninodes = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-b") && i + 1 < (uint32_t)argc)
+			nblocks = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-S") && i + 1 < (uint32_t)argc)
+			seed = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-o") && i + 1 < (uint32_t)argc)
+			out_name = argv[++i];
+		else if (argv[i][0] != '-' && dir == NULL)
+			dir = argv[i];
+		else
+			usage(argv[0]);
+	}
+	if (dir == NULL)
+		usage(argv[0]);
+
+	add_entry(".", "", DIR_FILE, 1);
+	if (scan_dir(dir, "", -1, 0, sorted) == -1)
+		return 1;
+
+	/* inodes and data blocks */
+	needed = 0;
+	for (i = 0; i < nfiles; i++)
+		needed += files[i].nblocks + files[i].nindirect;
+	if (ninodes == 0)
+		ninodes = 2 * (nfiles - 1);
+	if (nblocks == 0)
+		nblocks = 2 * needed;
+	if (ninodes < nfiles - 2 || nblocks < needed) {
+		fprintf(stderr, "need %u inodes and %u data blocks\n", nfiles - 2, needed);
+		return 1;
+	}
+	if (1 + ninodes > 64) {
+		fprintf(stderr, "warning: %u inodes do not fit the kernel's metadata cache for disks\n", ninodes);
+	}
+
+	/* files are placed in access order */
+	for (i = 0; i < nfiles; i++)
+		files[i].order = (uint32_t)-1;
+	if (order_name != NULL)
+		read_order(order_name);
+	for (i = 0; i < nfiles; i++)
+		if (files[i].order == (uint32_t)-1)
+			files[i].order = i;
+	order = xcalloc(nfiles, sizeof(*order));
+	for (i = 0; i < nfiles; i++)
+		order[i] = &files[i];
+	qsort(order, nfiles, sizeof(*order), cmp_order);
+
+	rand_state = seed;
+	inodes = xcalloc(ninodes, sizeof(uint32_t));
+	for (i = 0; i < ninodes; i++)
+		inodes[i] = i;
+	scatter = xcalloc(nblocks, sizeof(uint32_t));
+	for (i = 0; i < nblocks; i++)
+		scatter[i] = i;
+	if (!contiguous) {
+		shuffle(inodes, ninodes);
+		shuffle(scatter, nblocks);
+	}
+	contents = xcalloc(nblocks, sizeof(*contents));
+
+	used = 0;
+	for (i = 0; i < nfiles; i++)
+		if (has_inode(order[i]))
+			order[i]->inode = inodes[used++];
+
+	/* the data of a subdirectory is its dentries */
+	for (i = 0; i < nfiles; i++) {
+		f = &files[i];
+		if (!f->subdir)
+			continue;
+		f->data = xcalloc(f->count, ENTRY_SIZE);
+		for (j = 0; j < f->count; j++)
+			put_dentry(f->data + j * ENTRY_SIZE, &files[f->first + j]);
+	}
+
+	for (i = 0; i < nfiles; i++)
+		if (has_inode(order[i]))
+			place_file(order[i], contiguous, dedup);
+	used = next_block;
+
+	/* write it out */
+	data_start = 1 + ninodes;
+	img = xcalloc(data_start + nblocks, BLOCK_SIZE);
+	boot = img;
+	((uint32_t *)boot)[0] = nroot;
+	((uint32_t *)boot)[1] = ninodes;
+	((uint32_t *)boot)[2] = nblocks;
+	if (dedup)
+		((uint32_t *)boot)[FS_FLAGS_WORD] = FS_SHARED_BLOCKS;
+	for (i = 0; i < nroot; i++)
+		put_dentry(boot + ENTRY_SIZE * (i + 1), &files[i]);
+	for (i = 0; i < nblocks; i++)
+		if (contents[i] != NULL)
+			memcpy(img + (data_start + i) * BLOCK_SIZE, contents[i], BLOCK_SIZE);
+	for (i = 0; i < nfiles; i++)
+		if (has_inode(&files[i]))
+			map_file(&files[i], img, data_start);
+
+	if ((out = fopen(out_name, "wb")) == NULL) {
+		perror("open");
+		return 1;
+	}
+	if (fwrite(img, BLOCK_SIZE, data_start + nblocks, out) != data_start + nblocks) {
+		perror("write");
+		return 1;
+	}
+	fclose(out);
+
+	if (show)
+		report(order, ninodes, nblocks, used, dedup);
+	return 0;
+}
@@ -0,0 +1,398 @@
+#include "ata.h"
+
+#define ATA_TIMEOUT 1000000		// status polls before giving up on the drive
+
+/* the drive in use and its request in flight */
+static blkdev_t* ata_dev = NULL;
+static uint32_t ata_drive = ATA_MASTER;
+static blk_request_t* ata_req = NULL;
+static uint32_t ata_sectors_left;	// PIO sectors of ata_req not transferred yet
+
+/* bus master DMA, ata_bm_base is 0 when the controller or drive cannot do it.
+ * the kernel is identity mapped, so buffer addresses are physical addresses */
+static uint32_t ata_bm_base = 0;
+static uint32_t ata_prdt[4] __attribute__((aligned(16)));
+
+/*	ata_read_sector
+ *   DESCRIPTION: this function reads one sector from the data port
+ *   INPUTS: buf -- ATA_SECTOR_SIZE bytes to read into
+ *   OUTPUTS: buf
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+static inline void ata_read_sector(uint8_t* buf) {
+	uint32_t count = ATA_SECTOR_SIZE / 2;
+
+	asm volatile("cld; rep insw"
+			: "+D" (buf), "+c" (count)
+			: "d" (ATA_DATA)
+			: "memory");
+}
+
+/*	ata_write_sector
+ *   DESCRIPTION: this function writes one sector to the data port
+ *   INPUTS: buf -- ATA_SECTOR_SIZE bytes to write
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+static inline void ata_write_sector(const uint8_t* buf) {
+	uint32_t count = ATA_SECTOR_SIZE / 2;
+
+	asm volatile("cld; rep outsw"
+			: "+S" (buf), "+c" (count)
+			: "d" (ATA_DATA)
+			: "memory");
+}
+
+/*	ata_delay
+ *   DESCRIPTION: this function gives the drive the 400ns it needs to update its
+ *				  status after a command or a sector
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+static inline void ata_delay() {
+	inb(ATA_CTRL);
+	inb(ATA_CTRL);
+	inb(ATA_CTRL);
+	inb(ATA_CTRL);
+}
+
+/*	ata_wait
+ *   DESCRIPTION: this function polls the alternate status until the drive is not
+ *				  busy and, if asked, has data ready
+ *   INPUTS: drq -- 1 to also wait for DRQ
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the status, -1 on error or timeout
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t ata_wait(uint32_t drq) {
+	uint32_t i;
+	uint32_t status;
+
+	for(i=0;i<ATA_TIMEOUT;i++) {
+		status = inb(ATA_CTRL);
+		if(status & ATA_SR_BSY) {
+			continue;
+		}
+		if(status & (ATA_SR_ERR | ATA_SR_DF)) {
+			return -1;
+		}
+		if(!drq || (status & ATA_SR_DRQ)) {
+			return status;
+		}
+	}
+
+	return -1;
+}
+
+/*	ata_select
+ *   DESCRIPTION: this function loads the drive, LBA28 address and sector count
+ *				  of a transfer
+ *   INPUTS: lba -- first sector
+ *			 count -- number of sectors
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+static void ata_select(uint32_t lba, uint32_t count) {
+	outb(0xE0 | (ata_drive << 4) | ((lba >> 24) & 0x0F), ATA_DRIVE);
+	outb(count, ATA_SECCOUNT);
+	outb(lba & 0xFF, ATA_LBA_LO);
+	outb((lba >> 8) & 0xFF, ATA_LBA_MID);
+	outb((lba >> 16) & 0xFF, ATA_LBA_HI);
+}
+
+/*	pci_read
+ *   DESCRIPTION: this function reads a dword of PCI configuration space
+ *   INPUTS: bus, dev, func -- the PCI function
+ *			 reg -- register offset, dword aligned
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the register
+ *   SIDE EFFECTS: NONE
+ */
+static uint32_t pci_read(uint32_t bus, uint32_t dev, uint32_t func, uint32_t reg) {
+	outl(0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | reg, PCI_CONFIG_ADDRESS);
+	return inl(PCI_CONFIG_DATA);
+}
+
+/*	pci_write
+ *   DESCRIPTION: this function writes a dword of PCI configuration space
+ *   INPUTS: bus, dev, func -- the PCI function
+ *			 reg -- register offset, dword aligned
+ *			 val -- value to write
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+static void pci_write(uint32_t bus, uint32_t dev, uint32_t func, uint32_t reg, uint32_t val) {
+	outl(0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | reg, PCI_CONFIG_ADDRESS);
+	outl(val, PCI_CONFIG_DATA);
+}
+
+/*	ata_find_bus_master
+ *   DESCRIPTION: this function looks for an IDE controller on PCI bus 0 and turns
+ *				  on its bus mastering
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the bus master I/O base, 0 if there is none
+ *   SIDE EFFECTS: PCI command register of the controller updated
+ */
+static uint32_t ata_find_bus_master() {
+	uint32_t dev, func;
+	uint32_t bar;
+
+	for(dev=0;dev<32;dev++) {
+		for(func=0;func<8;func++) {
+			if((pci_read(0, dev, func, 0) & 0xFFFF) == 0xFFFF) {
+				continue;	// no function here
+			}
+			if((pci_read(0, dev, func, 0x08) >> 16) != PCI_CLASS_IDE) {
+				continue;
+			}
+
+			bar = pci_read(0, dev, func, 0x20);		// BAR4
+			if(!(bar & 0x01)) {
+				return 0;	// not an I/O space bar
+			}
+
+			pci_write(0, dev, func, 0x04, pci_read(0, dev, func, 0x04) | PCI_BUS_MASTER);
+			return bar & ~0x03;
+		}
+	}
+
+	return 0;
+}
+
+/*	ata_finish
+ *   DESCRIPTION: this function ends the request in flight
+ *   INPUTS: status -- BLK_DONE or BLK_ERROR
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: the next queued request is started
+ */
+static void ata_finish(int32_t status) {
+	ata_req = NULL;
+	blkdev_complete(ata_dev, status);
+}
+
+/*	ata_start
+ *   DESCRIPTION: this function starts a block transfer, with DMA when available
+ *				  and interrupt driven PIO otherwise
+ *   INPUTS: dev -- the drive
+ *			 req -- the request, its buffer must be in kernel memory
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: completes the request right away if the drive fails
+ */
+static void ata_start(blkdev_t* dev, blk_request_t* req) {
+	uint32_t lba = req->block * ATA_SECTORS_PER_BLOCK;
+	uint32_t adr = (uint32_t) req->buf;
+	uint32_t first;
+
+	ata_req = req;
+	ata_sectors_left = ATA_SECTORS_PER_BLOCK;
+
+	if(ata_wait(0) == -1) {
+		ata_finish(BLK_ERROR);
+		return;
+	}
+	outb(0, ATA_CTRL);	// interrupts on
+
+	if(ata_bm_base) {
+		// a region must not cross a 64KB boundary
+		first = 0x10000 - (adr & 0xFFFF);
+		if(first >= BLKDEV_BLOCK_SIZE) {
+			ata_prdt[0] = adr;
+			ata_prdt[1] = 0x80000000 | BLKDEV_BLOCK_SIZE;
+		}
+		else {
+			ata_prdt[0] = adr;
+			ata_prdt[1] = first;
+			ata_prdt[2] = adr + first;
+			ata_prdt[3] = 0x80000000 | (BLKDEV_BLOCK_SIZE - first);
+		}
+
+		outb(0, ata_bm_base + ATA_BM_COMMAND);
+		outl((uint32_t) ata_prdt, ata_bm_base + ATA_BM_PRDT);
+		outb(ATA_BM_SR_ERR | ATA_BM_SR_INTR, ata_bm_base + ATA_BM_STATUS);	// write 1 to clear
+		outb(req->op == BLK_READ ? ATA_BM_READ : 0, ata_bm_base + ATA_BM_COMMAND);
+
+		ata_select(lba, ATA_SECTORS_PER_BLOCK);
+		outb(req->op == BLK_READ ? ATA_CMD_READ_DMA : ATA_CMD_WRITE_DMA, ATA_COMMAND);
+		outb((req->op == BLK_READ ? ATA_BM_READ : 0) | ATA_BM_START, ata_bm_base + ATA_BM_COMMAND);
+		return;
+	}
+
+	ata_select(lba, ATA_SECTORS_PER_BLOCK);
+	if(req->op == BLK_READ) {
+		outb(ATA_CMD_READ_PIO, ATA_COMMAND);
+		return;		// an interrupt comes with every sector
+	}
+
+	// the first sector of a write goes out right away, the rest on interrupts
+	outb(ATA_CMD_WRITE_PIO, ATA_COMMAND);
+	ata_delay();
+	if(ata_wait(1) == -1) {
+		ata_finish(BLK_ERROR);
+		return;
+	}
+	ata_write_sector(req->buf);
+	ata_sectors_left--;
+	ata_delay();
+}
+
+/*	ata_service
+ *   DESCRIPTION: this function moves the request in flight forward from the
+ *				  drive's status. it only acts on what the status says, so it is
+ *				  safe to call from the interrupt handler and when polling
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: may complete the request
+ */
+static void ata_service() {
+	uint32_t status, bm_status;
+	uint8_t* buf;
+
+	if(!ata_req) {
+		inb(ATA_STATUS);	// acknowledge a stray interrupt
+		return;
+	}
+
+	if(ata_bm_base) {
+		bm_status = inb(ata_bm_base + ATA_BM_STATUS);
+		if(!(bm_status & ATA_BM_SR_INTR)) {
+			return;		// still transferring
+		}
+
+		outb(0, ata_bm_base + ATA_BM_COMMAND);
+		status = inb(ATA_STATUS);
+		outb(ATA_BM_SR_ERR | ATA_BM_SR_INTR, ata_bm_base + ATA_BM_STATUS);
+		ata_finish(((bm_status & ATA_BM_SR_ERR) || (status & (ATA_SR_ERR | ATA_SR_DF))) ? BLK_ERROR : BLK_DONE);
+		return;
+	}
+
+	while(1) {
+		status = inb(ATA_STATUS);
+		if(status & ATA_SR_BSY) {
+			return;		// wait for the next interrupt
+		}
+		if(status & (ATA_SR_ERR | ATA_SR_DF)) {
+			ata_finish(BLK_ERROR);
+			return;
+		}
+
+		if(!ata_sectors_left) {
+			ata_finish(BLK_DONE);	// last sector read, or last write accepted
+			return;
+		}
+		if(!(status & ATA_SR_DRQ)) {
+			return;
+		}
+
+		buf = ata_req->buf + (ATA_SECTORS_PER_BLOCK - ata_sectors_left) * ATA_SECTOR_SIZE;
+		if(ata_req->op == BLK_READ) {
+			ata_read_sector(buf);
+			ata_sectors_left--;
+			ata_delay();
+			if(!ata_sectors_left) {
+				ata_finish(BLK_DONE);
+				return;
+			}
+		}
+		else {
+			ata_write_sector(buf);
+			ata_sectors_left--;
+			ata_delay();
+			return;		// an interrupt comes once the drive took it
+		}
+	}
+}
+
+/*	ata_poll
+ *   DESCRIPTION: this function is the polling hook, used when waiting with
+ *				  interrupts disabled
+ *   INPUTS: dev -- the drive
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: may complete the request
+ */
+static void ata_poll(blkdev_t* dev) {
+	ata_service();
+}
+
+/*	do_handle_ata
+ *   DESCRIPTION: interrupt handler for the primary ATA channel
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: may complete the request, which runs its callback
+ */
+void do_handle_ata() {
+	ata_service();
+	send_eoi(ATA_IRQ);
+	enable_irq(ATA_IRQ);
+}
+
+/*	ata_init
+ *   DESCRIPTION: this function probes a drive of the primary channel with
+ *				  IDENTIFY and sets up a block device for it. DMA is used when
+ *				  the drive and a PCI IDE controller support it
+ *   INPUTS: dev -- the device to set up
+ *			 drive -- ATA_MASTER or ATA_SLAVE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if there is no ATA drive
+ *   SIDE EFFECTS: dev is reset
+ */
+int32_t ata_init(blkdev_t* dev, uint32_t drive) {
+	uint16_t id[ATA_SECTOR_SIZE / 2];
+	uint32_t sectors;
+
+	if(!dev || drive > ATA_SLAVE) {
+		return -1;
+	}
+
+	ata_drive = drive;
+	outb(0x02, ATA_CTRL);	// no interrupts while probing
+
+	outb(0xA0 | (drive << 4), ATA_DRIVE);
+	outb(0, ATA_SECCOUNT);
+	outb(0, ATA_LBA_LO);
+	outb(0, ATA_LBA_MID);
+	outb(0, ATA_LBA_HI);
+	outb(ATA_CMD_IDENTIFY, ATA_COMMAND);
+	ata_delay();
+
+	if(inb(ATA_STATUS) == 0 || inb(ATA_STATUS) == 0xFF) {
+		return -1;	// no drive
+	}
+	if(ata_wait(0) == -1 || inb(ATA_LBA_MID) || inb(ATA_LBA_HI)) {
+		return -1;	// not an ATA drive, ATAPI answers with a signature here
+	}
+	if(ata_wait(1) == -1) {
+		return -1;
+	}
+	ata_read_sector((uint8_t*) id);
+
+	sectors = id[60] | ((uint32_t) id[61] << 16);	// LBA28 sectors
+	if(!sectors) {
+		return -1;	// no LBA support
+	}
+
+	memset(dev, 0, sizeof(blkdev_t));
+	dev->num_blocks = sectors / ATA_SECTORS_PER_BLOCK;
+	dev->base = NULL;
+	dev->start = ata_start;
+	dev->poll = ata_poll;
+	dev->elevator = 1;
+	ata_dev = dev;
+
+	// word 49 bit 8 is DMA support
+	ata_bm_base = (id[49] & 0x100) ? ata_find_bus_master() : 0;
+
+	printf("ATA drive %d: %d blocks, %s\n", drive, dev->num_blocks, ata_bm_base ? "DMA" : "PIO");
+	return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "types.h"
+#include "lib.h"
+#include "i8259.h"
+#include "blkdev.h"
+
+#define ATA_IRQ 14
+
+/* primary channel registers */
+#define ATA_IO_BASE 0x1F0
+#define ATA_DATA (ATA_IO_BASE + 0)
+#define ATA_ERROR (ATA_IO_BASE + 1)
+#define ATA_SECCOUNT (ATA_IO_BASE + 2)
+#define ATA_LBA_LO (ATA_IO_BASE + 3)
+#define ATA_LBA_MID (ATA_IO_BASE + 4)
+#define ATA_LBA_HI (ATA_IO_BASE + 5)
+#define ATA_DRIVE (ATA_IO_BASE + 6)
+#define ATA_STATUS (ATA_IO_BASE + 7)
+#define ATA_COMMAND (ATA_IO_BASE + 7)
+#define ATA_CTRL 0x3F6				// alternate status on read, device control on write
+
+/* status bits */
+#define ATA_SR_ERR 0x01
+#define ATA_SR_DRQ 0x08
+#define ATA_SR_DF 0x20
+#define ATA_SR_BSY 0x80
+
+/* commands */
+#define ATA_CMD_READ_PIO 0x20
+#define ATA_CMD_WRITE_PIO 0x30
+#define ATA_CMD_READ_DMA 0xC8
+#define ATA_CMD_WRITE_DMA 0xCA
+#define ATA_CMD_IDENTIFY 0xEC
+
+/* bus master IDE registers, offsets from the base in BAR4 of the controller */
+#define ATA_BM_COMMAND 0
+#define ATA_BM_STATUS 2
+#define ATA_BM_PRDT 4
+#define ATA_BM_START 0x01
+#define ATA_BM_READ 0x08			// device to memory
+#define ATA_BM_SR_ERR 0x02
+#define ATA_BM_SR_INTR 0x04
+
+/* PCI configuration space */
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+#define PCI_CLASS_IDE 0x0101		// mass storage, IDE
+#define PCI_BUS_MASTER 0x04
+
+#define ATA_SECTOR_SIZE 512
+#define ATA_SECTORS_PER_BLOCK (BLKDEV_BLOCK_SIZE / ATA_SECTOR_SIZE)
+
+/* drives of the primary channel */
+#define ATA_MASTER 0
+#define ATA_SLAVE 1
+
+/*probe a drive of the primary channel and set up a block device for it*/
+extern int32_t ata_init(blkdev_t* dev, uint32_t drive);
+/*interrupt handler for the primary channel*/
+extern void do_handle_ata();
+
+#endif
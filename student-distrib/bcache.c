@@ -0,0 +1,543 @@
+#include "bcache.h"
+
+/* the cached blocks */
+bcache_entry_t bcache[BCACHE_SIZE];
+
+/* the device under the cache */
+static blkdev_t* bcache_dev = NULL;
+
+/* ends of the recently used list, and ticks since the last flush */
+static int32_t bcache_head = -1;
+static int32_t bcache_tail = -1;
+static uint32_t bcache_ticks = 0;
+
+uint32_t bcache_dirty_count = 0;
+bcache_stat_t bcache_stats;
+
+/*	bcache_unlink
+ *   DESCRIPTION: this function takes an entry off the recently used list
+ *   INPUTS: i -- index of the entry
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+static void bcache_unlink(int32_t i) {
+	if(bcache[i].prev != -1) {
+		bcache[bcache[i].prev].next = bcache[i].next;
+	}
+	else {
+		bcache_head = bcache[i].next;
+	}
+
+	if(bcache[i].next != -1) {
+		bcache[bcache[i].next].prev = bcache[i].prev;
+	}
+	else {
+		bcache_tail = bcache[i].prev;
+	}
+}
+
+/*	bcache_push_front
+ *   DESCRIPTION: this function puts an entry at the most recently used end
+ *   INPUTS: i -- index of the entry, not on the list
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+static void bcache_push_front(int32_t i) {
+	bcache[i].prev = -1;
+	bcache[i].next = bcache_head;
+	if(bcache_head != -1) {
+		bcache[bcache_head].prev = i;
+	}
+	bcache_head = i;
+	if(bcache_tail == -1) {
+		bcache_tail = i;
+	}
+}
+
+/*	bcache_push_back
+ *   DESCRIPTION: this function puts an entry at the least recently used end, so
+ *				  it is the first to be reused
+ *   INPUTS: i -- index of the entry, not on the list
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+static void bcache_push_back(int32_t i) {
+	bcache[i].next = -1;
+	bcache[i].prev = bcache_tail;
+	if(bcache_tail != -1) {
+		bcache[bcache_tail].next = i;
+	}
+	bcache_tail = i;
+	if(bcache_head == -1) {
+		bcache_head = i;
+	}
+}
+
+/*	bcache_init
+ *   DESCRIPTION: this function will initialize the block cache
+ *   INPUTS: dev -- the device to cache
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: every entry is freed, counters cleared
+ */
+void bcache_init(blkdev_t* dev) {
+	int32_t i;
+
+	bcache_dev = dev;
+	bcache_head = -1;
+	bcache_tail = -1;
+
+	for(i=0;i<BCACHE_SIZE;i++) {
+		bcache[i].block = BCACHE_NONE;
+		bcache[i].dirty = 0;
+		bcache_push_back(i);
+	}
+
+	bcache_dirty_count = 0;
+	bcache_ticks = 0;
+	memset(&bcache_stats, 0, sizeof(bcache_stats));
+}
+
+/*	bcache_find
+ *   DESCRIPTION: this function finds the entry caching a block
+ *   INPUTS: block -- device block number
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: index of the entry, -1 if the block is not cached
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t bcache_find(uint32_t block) {
+	int32_t i;
+
+	for(i=0;i<BCACHE_SIZE;i++) {
+		if(bcache[i].block == block) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*	bcache_done
+ *   DESCRIPTION: this function is the completion callback of every cache transfer.
+ *				  it runs in the device's interrupt handler or while polling
+ *   INPUTS: req -- the finished request of an entry
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: entry is no longer busy. a written entry is clean, a failed
+ *				   read is freed
+ */
+static void bcache_done(blk_request_t* req) {
+	bcache_entry_t* entry = (bcache_entry_t*) req->priv;
+
+	if(req->op == BLK_WRITE) {
+		if(req->status == BLK_DONE) {
+			entry->dirty = 0;
+			bcache_dirty_count--;
+			bcache_stats.writebacks++;
+		}
+	}
+	else if(req->status != BLK_DONE) {
+		entry->block = BCACHE_NONE;
+	}
+
+	entry->busy = 0;
+}
+
+/*	bcache_start
+ *   DESCRIPTION: this function starts a transfer between an entry and the device
+ *   INPUTS: entry -- the entry, not busy
+ *			 op -- BLK_READ or BLK_WRITE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the request could not be queued
+ *   SIDE EFFECTS: entry is busy until the transfer completes, which may be before
+ *				   this returns
+ */
+static int32_t bcache_start(bcache_entry_t* entry, uint32_t op) {
+	entry->busy = 1;
+	entry->req.block = entry->block;
+	entry->req.buf = entry->data;
+	entry->req.op = op;
+	entry->req.done = bcache_done;
+	entry->req.priv = entry;
+
+	if(blkdev_submit(bcache_dev, &entry->req) == -1) {
+		entry->busy = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*	bcache_sleep
+ *   DESCRIPTION: this function waits for some transfer to finish. if the caller
+ *				  had interrupts enabled the CPU sleeps until the next interrupt
+ *				  and other programs run meanwhile, otherwise the device is polled
+ *   INPUTS: flags -- the caller's saved flags, interrupts are disabled on entry
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: interrupts may be taken, anything in the cache may change
+ */
+static void bcache_sleep(uint32_t flags) {
+	if(flags & EFLAGS_IF) {
+		asm volatile("sti; hlt; cli");
+	}
+	else if(bcache_dev->poll) {
+		bcache_dev->poll(bcache_dev);
+	}
+}
+
+/*	bcache_victim
+ *   DESCRIPTION: this function picks the entry to reuse, the least recently used
+ *				  one that is not busy
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: index of the entry, -1 if every entry is busy
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t bcache_victim() {
+	int32_t i;
+
+	for(i=bcache_tail;i!=-1;i=bcache[i].prev) {
+		if(!bcache[i].busy) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*	bcache_get
+ *   DESCRIPTION: this function finds or fills the entry for a block and makes it
+ *				  the most recently used. on a miss the least recently used entry
+ *				  is reused, after writing it back if it is dirty. transfers are
+ *				  waited on with bcache_sleep
+ *   INPUTS: block -- device block number
+ *			 mode -- BCACHE_LOAD, BCACHE_ZERO or BCACHE_CACHED
+ *			 flags -- the caller's saved flags
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the entry, not busy, NULL if the block is not cached with
+ *				   BCACHE_CACHED or the device failed
+ *   SIDE EFFECTS: may write back or evict another block, call with interrupts disabled
+ */
+static bcache_entry_t* bcache_get(uint32_t block, uint32_t mode, uint32_t flags) {
+	int32_t i;
+	uint32_t loaded = 0;
+	int32_t written = -1;
+	bcache_entry_t* entry;
+
+	while(1) {
+		i = bcache_find(block);
+		if(i != -1) {
+			if(bcache[i].busy) {
+				bcache_sleep(flags);	// being read or written back
+				continue;
+			}
+			if(!loaded) {
+				bcache_stats.hits++;
+			}
+			bcache_unlink(i);
+			bcache_push_front(i);
+			return &bcache[i];
+		}
+
+		if(mode == BCACHE_CACHED || loaded) {
+			return NULL;	// not cached, or the read failed
+		}
+
+		i = bcache_victim();
+		if(i == -1) {
+			bcache_sleep(flags);	// every entry is busy
+			continue;
+		}
+
+		entry = &bcache[i];
+		if(entry->dirty) {
+			if(i == written) {
+				return NULL;	// write back failed, cannot drop the block
+			}
+			if(bcache_start(entry, BLK_WRITE) == -1) {
+				bcache_sleep(flags);	// queue is full
+			}
+			else {
+				written = i;
+			}
+			continue;	// look again once it is written back
+		}
+
+		if(entry->block != BCACHE_NONE) {
+			bcache_stats.evictions++;
+		}
+		entry->block = block;
+		bcache_unlink(i);
+		bcache_push_front(i);
+
+		if(mode == BCACHE_ZERO) {
+			memset(entry->data, 0, BCACHE_BLOCK_SIZE);
+			return entry;
+		}
+
+		if(bcache_start(entry, BLK_READ) == -1) {
+			entry->block = BCACHE_NONE;
+			return NULL;
+		}
+		bcache_stats.misses++;
+		loaded = 1;
+	}
+}
+
+/*	bcache_read
+ *   DESCRIPTION: this function copies part of a block out of the cache
+ *   INPUTS: block -- device block number
+ *			 offset -- offset within the block
+ *			 buf -- buffer to write to
+ *			 length -- number of bytes to copy
+ *			 mode -- BCACHE_LOAD to read the block from the device if it is not
+ *					 cached, BCACHE_CACHED to fail instead
+ *   OUTPUTS: buf
+ *   RETURN VALUE: 0 on success, -1 if the block is not cached with BCACHE_CACHED,
+ *				   or with invalid block or range
+ *   SIDE EFFECTS: the block becomes the most recently used
+ */
+int32_t bcache_read(uint32_t block, uint32_t offset, uint8_t* buf, uint32_t length, uint32_t mode) {
+	uint32_t flags;
+	bcache_entry_t* entry;
+
+	if(!bcache_dev || block >= bcache_dev->num_blocks || offset + length > BCACHE_BLOCK_SIZE) {
+		return -1;	// invalid block or past the end of block
+	}
+
+	cli_and_save(flags);
+	entry = bcache_get(block, mode == BCACHE_CACHED ? BCACHE_CACHED : BCACHE_LOAD, flags);
+	if(entry) {
+		memcpy(buf, entry->data + offset, length);
+	}
+	restore_flags(flags);
+
+	return entry ? 0 : -1;
+}
+
+/*	bcache_write
+ *   DESCRIPTION: this function copies data into a block through the cache. the
+ *				  device is only updated when the block is flushed or evicted
+ *   INPUTS: block -- device block number
+ *			 offset -- offset within the block
+ *			 buf -- data to write, NULL for zeros
+ *			 length -- number of bytes to write
+ *			 mode -- BCACHE_LOAD or BCACHE_ZERO, how to fill the block if not cached
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 with invalid block or range or if the device failed
+ *   SIDE EFFECTS: block is dirty
+ */
+int32_t bcache_write(uint32_t block, uint32_t offset, const uint8_t* buf, uint32_t length, uint32_t mode) {
+	uint32_t flags;
+	bcache_entry_t* entry;
+
+	if(!bcache_dev || block >= bcache_dev->num_blocks || offset + length > BCACHE_BLOCK_SIZE) {
+		return -1;	// invalid block or past the end of block
+	}
+
+	cli_and_save(flags);
+
+	entry = bcache_get(block, mode == BCACHE_ZERO ? BCACHE_ZERO : BCACHE_LOAD, flags);
+	if(!entry) {
+		restore_flags(flags);
+		return -1;
+	}
+
+	if(buf) {
+		memcpy(entry->data + offset, buf, length);
+	}
+	else {
+		memset(entry->data + offset, 0, length);	// no data means zeros
+	}
+
+	if(!entry->dirty) {
+		entry->dirty = 1;
+		bcache_dirty_count++;
+	}
+
+	restore_flags(flags);
+	return 0;
+}
+
+/*	bcache_prefetch
+ *   DESCRIPTION: this function starts reading a block into the cache and returns
+ *				  without waiting, used for read ahead. only a free or clean
+ *				  entry is reused, read ahead never waits for a write back
+ *   INPUTS: block -- device block number
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 if the block is cached or being read, -1 if there is no clean
+ *				   entry or the request could not be queued
+ *   SIDE EFFECTS: a clean block may be evicted
+ */
+int32_t bcache_prefetch(uint32_t block) {
+	uint32_t flags;
+	int32_t i;
+
+	if(!bcache_dev || block >= bcache_dev->num_blocks) {
+		return -1;
+	}
+
+	cli_and_save(flags);
+
+	if(bcache_find(block) != -1) {
+		restore_flags(flags);
+		return 0;	// cached or already in flight
+	}
+
+	i = bcache_victim();
+	if(i == -1 || bcache[i].dirty) {
+		restore_flags(flags);
+		return -1;
+	}
+
+	if(bcache[i].block != BCACHE_NONE) {
+		bcache_stats.evictions++;
+	}
+	bcache[i].block = block;
+	bcache_unlink(i);
+	bcache_push_front(i);
+
+	if(bcache_start(&bcache[i], BLK_READ) == -1) {
+		bcache[i].block = BCACHE_NONE;
+		restore_flags(flags);
+		return -1;
+	}
+	bcache_stats.readahead++;
+
+	restore_flags(flags);
+	return 0;
+}
+
+/*	bcache_invalidate
+ *   DESCRIPTION: this function drops a block from the cache without writing it back
+ *   INPUTS: block -- device block number
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: the entry is freed and reused first
+ */
+void bcache_invalidate(uint32_t block) {
+	uint32_t flags;
+	int32_t i;
+
+	cli_and_save(flags);
+
+	// a transfer in flight still owns the data
+	while((i = bcache_find(block)) != -1 && bcache[i].busy) {
+		bcache_sleep(flags);
+	}
+
+	if(i != -1) {
+		if(bcache[i].dirty) {
+			bcache_dirty_count--;
+		}
+		bcache[i].block = BCACHE_NONE;
+		bcache[i].dirty = 0;
+		bcache_unlink(i);
+		bcache_push_back(i);
+	}
+	restore_flags(flags);
+}
+
+/*	bcache_start_writeback
+ *   DESCRIPTION: this function starts writing back every dirty block that is not
+ *				  already being transferred, without waiting
+ *   INPUTS: started -- bitmap of entries already written by the caller, they are
+ *						skipped so a failing block is only tried once
+ *   OUTPUTS: started
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: call with interrupts disabled
+ */
+static void bcache_start_writeback(uint32_t* started) {
+	uint32_t i;
+
+	for(i=0;i<BCACHE_SIZE;i++) {
+		if(!bcache[i].busy && bcache[i].dirty && !(*started & (1 << i))) {
+			if(bcache_start(&bcache[i], BLK_WRITE) == 0) {
+				*started |= 1 << i;
+			}
+		}
+	}
+}
+
+/*	bcache_flush
+ *   DESCRIPTION: this function writes every dirty block back to the device. the
+ *				  writes are all queued before waiting on any of them, so the
+ *				  device can sort them
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: number of blocks written back
+ *   SIDE EFFECTS: every entry is clean unless the device failed
+ */
+int32_t bcache_flush() {
+	uint32_t flags;
+	uint32_t i;
+	uint32_t before;
+	uint32_t started = 0;
+	uint32_t pending;
+
+	cli_and_save(flags);
+	before = bcache_stats.writebacks;
+
+	do {
+		bcache_start_writeback(&started);
+
+		pending = 0;
+		for(i=0;i<BCACHE_SIZE;i++) {
+			if(bcache[i].busy || (bcache[i].dirty && !(started & (1 << i)))) {
+				pending = 1;
+			}
+		}
+		if(pending) {
+			bcache_sleep(flags);
+		}
+	} while(pending);
+
+	bcache_ticks = 0;
+	restore_flags(flags);
+
+	return bcache_stats.writebacks - before;
+}
+
+/*	bcache_tick
+ *   DESCRIPTION: this function is called on every PIT interrupt. every
+ *				  BCACHE_FLUSH_TICKS ticks it starts writing back the dirty blocks,
+ *				  they are marked clean as the writes complete
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: may start writes
+ */
+void bcache_tick() {
+	uint32_t flags;
+	uint32_t started = 0;
+
+	if(++bcache_ticks >= BCACHE_FLUSH_TICKS) {
+		if(bcache_dirty_count) {
+			cli_and_save(flags);
+			bcache_start_writeback(&started);
+			restore_flags(flags);
+		}
+		bcache_ticks = 0;
+	}
+}
+
+/*	bcache_get_stat
+ *   DESCRIPTION: this function copies the cache counters along with the device's
+ *   INPUTS: stat -- where to copy the counters
+ *   OUTPUTS: stat
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+void bcache_get_stat(bcache_stat_t* stat) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	*stat = bcache_stats;
+	stat->dev_reads = bcache_dev ? bcache_dev->reads : 0;
+	stat->dev_writes = bcache_dev ? bcache_dev->writes : 0;
+	restore_flags(flags);
+}
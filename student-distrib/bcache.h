@@ -0,0 +1,68 @@
+#ifndef _BCACHE_H
+#define _BCACHE_H
+
+#include "types.h"
+#include "lib.h"
+#include "blkdev.h"
+
+#define BCACHE_BLOCK_SIZE BLKDEV_BLOCK_SIZE
+#define BCACHE_SIZE 32				// number of cached blocks
+#define BCACHE_FLUSH_TICKS 500		// PIT ticks between write backs, 5s at 100Hz
+#define BCACHE_NONE 0xFFFFFFFF
+
+/* modes for bcache_read and bcache_write, what to do if the block is not cached */
+#define BCACHE_LOAD 0		// fill a new entry from the device
+#define BCACHE_ZERO 1		// fill a new entry with zeros, for newly allocated blocks
+#define BCACHE_CACHED 2		// fail, only look at blocks already cached
+
+/* a cached copy of one device block. entries are kept on a list from most to
+ * least recently used and the least recently used one is reused on a miss.
+ * while a transfer is in flight the entry is busy and nobody touches data */
+typedef struct bcache_entry
+{
+	uint32_t block;			// device block number, BCACHE_NONE if the entry is free
+	uint32_t dirty;			// 1 if newer than the device
+	volatile uint32_t busy;	// 1 while req is in flight, cleared by its completion
+	int32_t prev;			// more recently used entry, -1 at the head
+	int32_t next;			// less recently used entry, -1 at the tail
+	blk_request_t req;		// transfer of this entry
+	uint8_t data[BCACHE_BLOCK_SIZE];
+} bcache_entry_t;
+
+/* cache counters, returned by the cachestat system call */
+typedef struct bcache_stat
+{
+	uint32_t hits;			// block accesses served by the cache
+	uint32_t misses;		// blocks read from the device into the cache
+	uint32_t direct;		// block accesses served straight from a memory resident device
+	uint32_t evictions;		// cached blocks dropped to make room
+	uint32_t writebacks;	// dirty blocks written to the device
+	uint32_t readahead;		// blocks requested ahead of a sequential reader
+	uint32_t dev_reads;		// block reads done by the device
+	uint32_t dev_writes;	// block writes done by the device
+} bcache_stat_t;
+
+/*init function for the block cache over a device*/
+extern void bcache_init(blkdev_t* dev);
+
+/*copy part of a block out of the cache*/
+extern int32_t bcache_read(uint32_t block, uint32_t offset, uint8_t* buf, uint32_t length, uint32_t mode);
+/*copy data into a block through the cache and mark it dirty*/
+extern int32_t bcache_write(uint32_t block, uint32_t offset, const uint8_t* buf, uint32_t length, uint32_t mode);
+/*start reading a block into the cache without waiting for it*/
+extern int32_t bcache_prefetch(uint32_t block);
+/*drop a block without writing it back, used when the block is freed*/
+extern void bcache_invalidate(uint32_t block);
+
+/*write every dirty block back to the device*/
+extern int32_t bcache_flush();
+/*called on every PIT tick, flushes every BCACHE_FLUSH_TICKS*/
+extern void bcache_tick();
+/*copy the counters*/
+extern void bcache_get_stat(bcache_stat_t* stat);
+
+/*number of dirty blocks, readers of memory resident devices can skip the cache when it is 0*/
+extern uint32_t bcache_dirty_count;
+extern bcache_stat_t bcache_stats;
+
+#endif
@@ -0,0 +1,233 @@
+#include "blkdev.h"
+
+/*	blkdev_sweep_key
+ *   DESCRIPTION: this function orders blocks for the elevator. the head sweeps up
+ *				  from the block in flight and jumps back to the lowest block
+ *				  once nothing is left above it
+ *   INPUTS: dev -- the device
+ *			 cur -- block of the request in flight
+ *			 block -- block to order
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: distance of the block along the sweep
+ *   SIDE EFFECTS: NONE
+ */
+static uint32_t blkdev_sweep_key(blkdev_t* dev, uint32_t cur, uint32_t block) {
+	if(block >= cur) {
+		return block - cur;
+	}
+	return dev->num_blocks - cur + block;
+}
+
+/*	blkdev_submit
+ *   DESCRIPTION: this function queues a request on a device. the request is started
+ *				  right away if the device is idle, otherwise when the requests before
+ *				  it are done. devices with an elevator take queued requests in
+ *				  block order instead of arrival order
+ *   INPUTS: dev -- the device
+ *			 req -- the request, block, buf, op and done filled in by the caller
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 with invalid block, a write to a read only
+ *				   device or a full queue
+ *   SIDE EFFECTS: req->status is BLK_PENDING until it completes
+ */
+int32_t blkdev_submit(blkdev_t* dev, blk_request_t* req) {
+	uint32_t flags;
+	uint32_t pos, i, cur, key;
+
+	if(!dev || !req || !req->buf || req->block >= dev->num_blocks) {
+		return -1;	// invalid device, request or block
+	}
+	if(req->op == BLK_WRITE && dev->read_only) {
+		return -1;
+	}
+
+	cli_and_save(flags);
+
+	if(dev->count >= BLK_QUEUE_SIZE) {
+		restore_flags(flags);
+		return -1;	// queue is full
+	}
+
+	req->dev = dev;
+	req->status = BLK_PENDING;
+	pos = dev->count;
+
+	// the request in flight stays first, the rest are sorted along the sweep
+	if(dev->elevator && dev->count) {
+		cur = dev->queue[dev->head]->block;
+		key = blkdev_sweep_key(dev, cur, req->block);
+		for(pos=1;pos<dev->count;pos++) {
+			if(blkdev_sweep_key(dev, cur, dev->queue[(dev->head + pos) % BLK_QUEUE_SIZE]->block) > key) {
+				break;
+			}
+		}
+		for(i=dev->count;i>pos;i--) {
+			dev->queue[(dev->head + i) % BLK_QUEUE_SIZE] = dev->queue[(dev->head + i - 1) % BLK_QUEUE_SIZE];
+		}
+	}
+
+	dev->queue[(dev->head + pos) % BLK_QUEUE_SIZE] = req;
+	dev->count++;
+
+	if(dev->count == 1) {
+		dev->start(dev, req);	// device was idle
+	}
+
+	restore_flags(flags);
+	return 0;
+}
+
+/*	blkdev_complete
+ *   DESCRIPTION: this function is called by a driver when the request in flight is
+ *				  done. it runs the completion callback and starts the next request
+ *   INPUTS: dev -- the device
+ *			 status -- BLK_DONE or BLK_ERROR
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: request dequeued
+ */
+void blkdev_complete(blkdev_t* dev, int32_t status) {
+	uint32_t flags;
+	blk_request_t* req;
+
+	cli_and_save(flags);
+
+	if(!dev->count) {
+		restore_flags(flags);
+		return;		// spurious completion
+	}
+
+	req = dev->queue[dev->head];
+	dev->head = (dev->head + 1) % BLK_QUEUE_SIZE;
+	dev->count--;
+
+	if(status == BLK_DONE) {
+		if(req->op == BLK_READ) {
+			dev->reads++;
+		}
+		else {
+			dev->writes++;
+		}
+	}
+
+	req->status = status;
+	if(req->done) {
+		req->done(req);
+	}
+
+	if(dev->count) {
+		dev->start(dev, dev->queue[dev->head]);
+	}
+
+	restore_flags(flags);
+}
+
+/*	blkdev_wait
+ *   DESCRIPTION: this function waits until a request is done. with interrupts
+ *				  enabled it sleeps until the next interrupt, with interrupts
+ *				  disabled it polls the driver
+ *   INPUTS: req -- a submitted request
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the transfer failed
+ *   SIDE EFFECTS: NONE
+ */
+int32_t blkdev_wait(blk_request_t* req) {
+	uint32_t flags;
+
+	while(req->status == BLK_PENDING) {
+		cli_and_save(flags);
+		if(req->status == BLK_PENDING) {
+			if(flags & EFLAGS_IF) {
+				asm volatile("sti; hlt");	// no interrupt can slip in between the two
+			}
+			else if(req->dev->poll) {
+				req->dev->poll(req->dev);
+			}
+		}
+		restore_flags(flags);
+	}
+
+	return req->status == BLK_DONE ? 0 : -1;
+}
+
+/*	blkdev_rw
+ *   DESCRIPTION: this function reads or writes one block and waits for it
+ *   INPUTS: dev -- the device
+ *			 op -- BLK_READ or BLK_WRITE
+ *			 block -- block number on the device
+ *			 buf -- BLKDEV_BLOCK_SIZE bytes to read into or write from
+ *   OUTPUTS: buf for reads
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: NONE
+ */
+int32_t blkdev_rw(blkdev_t* dev, uint32_t op, uint32_t block, uint8_t* buf) {
+	blk_request_t req;
+
+	req.block = block;
+	req.buf = buf;
+	req.op = op;
+	req.done = NULL;
+	req.priv = NULL;
+
+	if(blkdev_submit(dev, &req) == -1) {
+		return -1;
+	}
+
+	return blkdev_wait(&req);
+}
+
+/*	blkdev_direct
+ *   DESCRIPTION: this function finds where a block sits in memory, only memory
+ *				  resident devices have one
+ *   INPUTS: dev -- the device
+ *			 block -- block number on the device
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: address of the block, NULL if the device is not memory resident
+ *				   or the block is invalid
+ *   SIDE EFFECTS: NONE
+ */
+uint8_t* blkdev_direct(blkdev_t* dev, uint32_t block) {
+	if(!dev || !dev->base || block >= dev->num_blocks) {
+		return NULL;
+	}
+
+	return dev->base + block*BLKDEV_BLOCK_SIZE;
+}
+
+/*	ramdisk_start
+ *   DESCRIPTION: this function does a ramdisk transfer, it completes right away
+ *   INPUTS: dev -- the ramdisk
+ *			 req -- the request
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: request completed
+ */
+static void ramdisk_start(blkdev_t* dev, blk_request_t* req) {
+	uint8_t* adr = dev->base + req->block*BLKDEV_BLOCK_SIZE;
+
+	if(req->op == BLK_READ) {
+		memcpy(req->buf, adr, BLKDEV_BLOCK_SIZE);
+	}
+	else {
+		memcpy(adr, req->buf, BLKDEV_BLOCK_SIZE);
+	}
+
+	blkdev_complete(dev, BLK_DONE);
+}
+
+/*	ramdisk_init
+ *   DESCRIPTION: this function sets up a memory resident block device
+ *   INPUTS: dev -- the device to set up
+ *			 base -- address of block 0
+ *			 num_blocks -- number of blocks
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: dev is reset
+ */
+void ramdisk_init(blkdev_t* dev, uint8_t* base, uint32_t num_blocks) {
+	memset(dev, 0, sizeof(blkdev_t));
+	dev->base = base;
+	dev->num_blocks = num_blocks;
+	dev->start = ramdisk_start;
+	dev->poll = NULL;
+}
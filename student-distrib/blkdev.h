@@ -0,0 +1,71 @@
+#ifndef _BLKDEV_H
+#define _BLKDEV_H
+
+#include "types.h"
+#include "lib.h"
+
+#define BLKDEV_BLOCK_SIZE 4096
+#define BLK_QUEUE_SIZE 32		// outstanding requests per device
+#define EFLAGS_IF 0x200			// interrupt enable flag, decides how to wait
+
+/* request operations */
+#define BLK_READ 0
+#define BLK_WRITE 1
+
+/* request status */
+#define BLK_DONE 0
+#define BLK_ERROR -1
+#define BLK_PENDING 1
+
+struct blkdev;
+
+/* one block transfer. the submitter owns the request until it completes */
+typedef struct blk_request
+{
+	struct blkdev* dev;
+	uint32_t block;			// block number on the device
+	uint8_t* buf;			// BLKDEV_BLOCK_SIZE bytes to read into or write from
+	uint32_t op;			// BLK_READ or BLK_WRITE
+	volatile int32_t status;	// BLK_PENDING until the device completes it
+	void (*done)(struct blk_request* req);	// completion callback, may be NULL
+	void* priv;				// for the submitter
+} blk_request_t;
+
+/* a block device and its request queue */
+typedef struct blkdev
+{
+	uint32_t num_blocks;
+	uint8_t* base;			// set when every block is resident in memory, enables zero copy access
+
+	/* driver hooks. start begins a request, the driver calls blkdev_complete when
+	 * it is done. poll completes outstanding requests with interrupts disabled and
+	 * may be NULL for drivers that complete inside start */
+	void (*start)(struct blkdev* dev, blk_request_t* req);
+	void (*poll)(struct blkdev* dev);
+	void* priv;
+
+	blk_request_t* queue[BLK_QUEUE_SIZE];	// pending requests, queue[head] is in flight
+	uint32_t head;
+	uint32_t count;
+	uint32_t elevator;		// 1 to keep the queue sorted in one sweep direction, for seeking devices
+	uint32_t read_only;		// 1 to reject writes, the file system is mounted read only
+
+	uint32_t reads;			// completed block reads
+	uint32_t writes;		// completed block writes
+} blkdev_t;
+
+/*queue a request, it is started once the requests before it are done*/
+extern int32_t blkdev_submit(blkdev_t* dev, blk_request_t* req);
+/*called by drivers when the request in flight is done*/
+extern void blkdev_complete(blkdev_t* dev, int32_t status);
+/*wait until a request is done*/
+extern int32_t blkdev_wait(blk_request_t* req);
+/*read or write one block and wait for it*/
+extern int32_t blkdev_rw(blkdev_t* dev, uint32_t op, uint32_t block, uint8_t* buf);
+/*address of a block for memory resident devices, NULL otherwise*/
+extern uint8_t* blkdev_direct(blkdev_t* dev, uint32_t block);
+
+/*set up a memory resident device, like the boot module image*/
+extern void ramdisk_init(blkdev_t* dev, uint8_t* base, uint32_t num_blocks);
+
+#endif
@@ -0,0 +1,118 @@
+#include "dcache.h"
+
+static dcache_entry_t dcache[DCACHE_SIZE];
+static uint32_t dcache_clock = 0;
+
+dcache_stat_t dcache_stats;
+
+/*	dcache_reset
+ *   DESCRIPTION: this function drops every cached lookup
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: cache and counters cleared
+ */
+void dcache_reset() {
+	uint32_t i;
+
+	for(i=0;i<DCACHE_SIZE;i++) {
+		dcache[i].dir = DCACHE_FREE;
+	}
+	dcache_clock = 0;
+	memset(&dcache_stats, 0, sizeof(dcache_stats));
+}
+
+/*	dcache_slot
+ *   DESCRIPTION: this function mixes the directory into the name hash to find the
+ *				  home slot of a key, the key may sit in any of the DCACHE_WAYS
+ *				  slots from there
+ *   INPUTS: dir -- inode of the directory
+ *			 hash -- hash of the name
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the home slot
+ *   SIDE EFFECTS: NONE
+ */
+static uint32_t dcache_slot(uint32_t dir, uint32_t hash) {
+	return (hash ^ (dir * 2654435761U)) & DCACHE_MASK;
+}
+
+/*	dcache_lookup
+ *   DESCRIPTION: this function looks up a name of a directory in the cache
+ *   INPUTS: dir -- inode of the directory
+ *			 name -- the name, not necessarily null terminated
+ *			 len -- bytes of the name
+ *			 hash -- hash of the name
+ *			 dentry -- filled in if the name is found
+ *   OUTPUTS: dentry
+ *   RETURN VALUE: 0 if the name is in the directory, -1 if it is known not to be,
+ *				   1 if the lookup is not cached
+ *   SIDE EFFECTS: NONE
+ */
+int32_t dcache_lookup(uint32_t dir, const uint8_t* name, uint32_t len, uint32_t hash, dentry_t* dentry) {
+	uint32_t i, slot;
+	dcache_entry_t* entry;
+
+	slot = dcache_slot(dir, hash);
+	for(i=0;i<DCACHE_WAYS;i++) {
+		entry = &dcache[(slot + i) & DCACHE_MASK];
+		if(entry->dir != dir || entry->hash != hash || entry->name_len != len ||
+			strncmp((int8_t*)entry->fname, (int8_t*)name, len) != 0) {
+			continue;
+		}
+
+		entry->stamp = ++dcache_clock;
+		if(entry->type == DCACHE_NEGATIVE) {
+			dcache_stats.negative_hits++;
+			return -1;
+		}
+
+		dcache_stats.hits++;
+		memset(dentry, 0, sizeof(dentry_t));
+		memcpy(dentry->fname, entry->fname, FNAME_SIZE);
+		dentry->type = entry->type;
+		dentry->inode = entry->inode;
+		return 0;
+	}
+
+	dcache_stats.misses++;
+	return 1;
+}
+
+/*	dcache_insert
+ *   DESCRIPTION: this function remembers the result of a lookup in the least
+ *				  recently used slot of the key
+ *   INPUTS: dir -- inode of the directory
+ *			 name -- the name, not necessarily null terminated
+ *			 len -- bytes of the name, at most FNAME_SIZE
+ *			 hash -- hash of the name
+ *			 dentry -- the dentry found, NULL if the name is not in the directory
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: another cached lookup may be dropped
+ */
+void dcache_insert(uint32_t dir, const uint8_t* name, uint32_t len, uint32_t hash, const dentry_t* dentry) {
+	uint32_t i, slot;
+	dcache_entry_t* entry;
+	dcache_entry_t* victim = NULL;
+
+	slot = dcache_slot(dir, hash);
+	for(i=0;i<DCACHE_WAYS;i++) {
+		entry = &dcache[(slot + i) & DCACHE_MASK];
+		if(entry->dir == DCACHE_FREE) {
+			victim = entry;
+			break;
+		}
+		if(!victim || entry->stamp < victim->stamp) {
+			victim = entry;
+		}
+	}
+
+	victim->dir = dir;
+	victim->hash = hash;
+	victim->name_len = len;
+	memset(victim->fname, 0, FNAME_SIZE);
+	memcpy(victim->fname, name, len);
+	victim->type = dentry ? dentry->type : DCACHE_NEGATIVE;
+	victim->inode = dentry ? dentry->inode : 0;
+	victim->stamp = ++dcache_clock;
+}
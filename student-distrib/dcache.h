@@ -0,0 +1,45 @@
+#ifndef _DCACHE_H
+#define _DCACHE_H
+
+#include "types.h"
+#include "lib.h"
+#include "fs.h"
+
+/* number of cached lookups, must be a power of 2 */
+#define DCACHE_SIZE 256
+#define DCACHE_MASK (DCACHE_SIZE - 1)
+#define DCACHE_WAYS 4				// slots probed from the home slot of a key
+#define DCACHE_FREE 0xFFFFFFFF		// dir of an unused slot
+#define DCACHE_NEGATIVE 0xFFFFFFFF	// type of a name that is not in the directory
+
+/* the result of looking up one name in a subdirectory, keyed by the inode of
+ * the directory and the name. a negative entry remembers that the name does
+ * not exist so a failed lookup does not scan the directory again either */
+typedef struct dcache_entry
+{
+	uint32_t dir;			// inode of the directory, DCACHE_FREE if the slot is unused
+	uint32_t hash;			// hash of the name
+	uint32_t name_len;
+	uint8_t fname[FNAME_SIZE];
+	uint32_t type;			// type of the dentry, DCACHE_NEGATIVE if not found
+	uint32_t inode;
+	uint32_t stamp;			// last use, the oldest slot of a key is replaced
+} dcache_entry_t;
+
+typedef struct dcache_stat
+{
+	uint32_t hits;
+	uint32_t negative_hits;		// hits that found the name does not exist
+	uint32_t misses;
+} dcache_stat_t;
+
+/*drop every cached lookup, called when a file system is mounted*/
+extern void dcache_reset();
+/*look up a name in a directory, 0 found, -1 not in the directory, 1 not cached*/
+extern int32_t dcache_lookup(uint32_t dir, const uint8_t* name, uint32_t len, uint32_t hash, dentry_t* dentry);
+/*remember the result of a lookup, dentry is NULL if the name does not exist*/
+extern void dcache_insert(uint32_t dir, const uint8_t* name, uint32_t len, uint32_t hash, const dentry_t* dentry);
+
+extern dcache_stat_t dcache_stats;
+
+#endif
@@ -0,0 +1,111 @@
+#include "devfs.h"
+#include "mouse.h"
+
+/* tty is the terminal of the process that opens it, the same as stdin and stdout */
+static devfs_node_t devfs_nodes[] = {
+	{ "rtc", RTC_FILE, &rtc_fops, (int32_t (*)(fd_t*)) rtc_open },
+	{ "tty", TMN_FILE, &terminal_fops, NULL },
+	{ "mouse", MOUSE_FILE, &mouse_fops, NULL },
+};
+#define DEVFS_NUM_NODES (sizeof(devfs_nodes) / sizeof(devfs_node_t))
+
+static int32_t devfs_lookup(const uint8_t* path, uint32_t* ino, uint32_t* type);
+static int32_t devfs_fill(vnode_t* vnode);
+static vfs_ops_t devfs_ops = { devfs_lookup, devfs_fill, NULL, NULL, NULL };
+
+/*	devfs_init
+ *   DESCRIPTION: this function mounts the device files at /dev
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: vfs mount table updated
+ */
+void devfs_init() {
+	if(!vfs_mount((uint8_t*)"/dev", &devfs_ops)) {
+		printf("cannot mount /dev\n");
+	}
+}
+
+/*	devfs_lookup
+ *   DESCRIPTION: this function finds a device file by name, the empty path is the
+ *				  /dev directory itself
+ *   INPUTS: path -- the path below /dev
+ *			 ino -- filled in with the index of the device in the table
+ *			 type -- filled in with the type of the device
+ *   OUTPUTS: ino, type
+ *   RETURN VALUE: 0 on success, -1 if there is no such device
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t devfs_lookup(const uint8_t* path, uint32_t* ino, uint32_t* type) {
+	uint32_t i;
+
+	if(path[0] == '\0') {
+		*ino = VFS_ROOT_INO;
+		*type = DIR_FILE;
+		return 0;
+	}
+
+	for(i=0;i<DEVFS_NUM_NODES;i++) {
+		if(strncmp(devfs_nodes[i].name, (int8_t*)path, strlen(devfs_nodes[i].name) + 1) == 0) {
+			*ino = i;
+			*type = devfs_nodes[i].type;
+			return 0;
+		}
+	}
+
+	return -1;	// no such device
+}
+
+/*	devfs_fill
+ *   DESCRIPTION: this function sets up the vnode of a device file
+ *   INPUTS: vnode -- the vnode, ino and type filled in by devfs_lookup
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if there is no such device
+ *   SIDE EFFECTS: vnode modified
+ */
+static int32_t devfs_fill(vnode_t* vnode) {
+
+	if(vnode->ino == VFS_ROOT_INO) {
+		vnode->fops = &devfs_fops;
+		return 0;
+	}
+
+	if(vnode->ino >= DEVFS_NUM_NODES) {
+		return -1;
+	}
+
+	vnode->fops = devfs_nodes[vnode->ino].fops;
+	vnode->open = devfs_nodes[vnode->ino].open;
+	return 0;
+}
+
+/*	devfs_dir_read
+ *   DESCRIPTION: this function reads the name of the next device file of /dev,
+ *				  file_pos of the descriptor is the index of the next device
+ *   INPUTS: file_desc -- file descriptor of /dev
+ *			 buf   -- buffer to write to
+ *			 nbytes -- size of buf
+ *   OUTPUTS: write the device name into buf
+ *   RETURN VALUE: number of bytes written, 0 if end of directory reached
+ *   SIDE EFFECTS: buf is modified
+ */
+int32_t devfs_dir_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes) {
+	uint32_t len;
+
+	if(!file_desc || !buf) {
+		return -1;	// null pointer
+	}
+
+	if(file_desc->file_pos >= DEVFS_NUM_NODES) {
+		return 0;	//end of directory reached
+	}
+
+	len = strlen(devfs_nodes[file_desc->file_pos].name);
+	if(len > nbytes) {
+		len = nbytes;
+	}
+	memcpy(buf, devfs_nodes[file_desc->file_pos].name, len);
+
+	file_desc->file_pos++;
+	return len;
+}
@@ -0,0 +1,23 @@
+#ifndef _DEVFS_H
+#define _DEVFS_H
+
+#include "types.h"
+#include "lib.h"
+#include "vfs.h"
+#include "syscalls.h"
+
+/* a device file under /dev, the devices are a fixed table */
+typedef struct devfs_node
+{
+	int8_t* name;
+	uint32_t type;			// one of the xxx_FILE types
+	fops_table_t* fops;
+	int32_t (*open)(fd_t* file_desc);	// device setup at every open, or NULL
+} devfs_node_t;
+
+/*mounts the device files at /dev*/
+extern void devfs_init();
+/*reads the name of the next device file of /dev*/
+extern int32_t devfs_dir_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes);
+
+#endif
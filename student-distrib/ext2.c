@@ -0,0 +1,596 @@
+#include "ext2.h"
+#include "syscalls.h"
+
+/* the device an ext2 boot module is mounted from */
+blkdev_t ext2_ramdisk;
+
+static uint8_t* ext2_image = NULL;		// block 0 of the mounted file system
+static uint32_t ext2_image_size;
+static ext2_super_t ext2_sb;
+
+/* inode table block of every group, read from the group descriptors at mount */
+static uint32_t ext2_inode_table[EXT2_MAX_GROUPS];
+
+static ext2_inode_t ext2_icache[EXT2_ICACHE_SIZE];
+
+/* name index, and the directories whose every name is in it */
+static ext2_name_t ext2_names[EXT2_HASH_SIZE];
+static uint32_t ext2_names_used;
+static uint32_t ext2_indexed[EXT2_MAX_INDEXED_DIRS];
+static uint32_t ext2_num_indexed;
+
+static int32_t ext2_vnode_lookup(const uint8_t* path, uint32_t* ino, uint32_t* type);
+static int32_t ext2_vnode_fill(vnode_t* vnode);
+static vfs_ops_t ext2_vfs_ops = { ext2_vnode_lookup, ext2_vnode_fill, NULL, NULL, NULL };
+
+/*	ext2_probe
+ *   DESCRIPTION: this function checks whether an image starts with an ext2 file
+ *				  system by the magic number of its superblock
+ *   INPUTS: image -- the image
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 1 if it does, 0 otherwise
+ *   SIDE EFFECTS: NONE
+ */
+int32_t ext2_probe(uint8_t* image) {
+	return image && *(uint16_t*)(image + EXT2_SUPER_OFFSET + 56) == EXT2_MAGIC;
+}
+
+/*	ext2_init
+ *   DESCRIPTION: this function mounts an ext2 boot module at EXT2_MOUNT_PATH
+ *   INPUTS: image -- the module
+ *			 length -- size of the module in bytes
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if it is not an ext2 file system the driver
+ *				   can read
+ *   SIDE EFFECTS: ext2_ramdisk set up and mounted
+ */
+int32_t ext2_init(uint8_t* image, uint32_t length) {
+
+	if(!ext2_probe(image)) {
+		return -1;
+	}
+
+	ramdisk_init(&ext2_ramdisk, image, (length + BLKDEV_BLOCK_SIZE - 1) / BLKDEV_BLOCK_SIZE);
+	if(ext2_mount(&ext2_ramdisk, (uint8_t*)EXT2_MOUNT_PATH) == -1) {
+		printf("ext2 module is invalid or uses unsupported features\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*	ext2_mount
+ *   DESCRIPTION: this function mounts the ext2 file system of a memory resident
+ *				  device read only. the superblock and the inode table address of
+ *				  every block group are read once here
+ *   INPUTS: dev -- the device
+ *			 path -- where to mount it
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the device is not memory resident or the
+ *				   file system is invalid or uses features the driver lacks
+ *   SIDE EFFECTS: caches reset, vfs mount table updated
+ */
+int32_t ext2_mount(blkdev_t* dev, const uint8_t* path) {
+	uint8_t* sb;
+	uint8_t* gd;
+	uint32_t i, log_size, rev;
+
+	if(!dev || !dev->base || !ext2_probe(dev->base)) {
+		return -1;
+	}
+
+	sb = dev->base + EXT2_SUPER_OFFSET;
+	log_size = *(uint32_t*)(sb + 24);
+	rev = *(uint32_t*)(sb + 76);
+	if(log_size > 2) {
+		return -1;	// blocks larger than 4kB
+	}
+
+	ext2_sb.inodes_count = *(uint32_t*)(sb + 0);
+	ext2_sb.blocks_count = *(uint32_t*)(sb + 4);
+	ext2_sb.first_data_block = *(uint32_t*)(sb + 20);
+	ext2_sb.block_size = 1024 << log_size;
+	ext2_sb.blocks_per_group = *(uint32_t*)(sb + 32);
+	ext2_sb.inodes_per_group = *(uint32_t*)(sb + 40);
+	ext2_sb.inode_size = EXT2_GOOD_OLD_INODE_SIZE;
+	ext2_sb.filetype = 0;
+	if(rev >= 1) {
+		ext2_sb.inode_size = *(uint16_t*)(sb + 88);
+		if(*(uint32_t*)(sb + 96) & ~EXT2_FEATURE_INCOMPAT_SUPP) {
+			return -1;	// compression, journal recovery, extents and such
+		}
+		ext2_sb.filetype = (*(uint32_t*)(sb + 96) & EXT2_FEATURE_INCOMPAT_FILETYPE) != 0;
+	}
+
+	if(!ext2_sb.blocks_per_group || !ext2_sb.inodes_per_group ||
+		ext2_sb.blocks_count <= ext2_sb.first_data_block ||
+		ext2_sb.inode_size < EXT2_GOOD_OLD_INODE_SIZE || ext2_sb.inode_size > ext2_sb.block_size ||
+		ext2_sb.blocks_count > dev->num_blocks * (BLKDEV_BLOCK_SIZE / ext2_sb.block_size)) {
+		return -1;	// not a sane superblock, or larger than the device
+	}
+
+	ext2_sb.num_groups = (ext2_sb.blocks_count - ext2_sb.first_data_block + ext2_sb.blocks_per_group - 1) / ext2_sb.blocks_per_group;
+	if(ext2_sb.num_groups > EXT2_MAX_GROUPS ||
+		(ext2_sb.num_groups * EXT2_GROUP_DESC_SIZE + ext2_sb.block_size - 1) / ext2_sb.block_size > ext2_sb.blocks_count) {
+		return -1;	// too many groups to keep in memory
+	}
+
+	ext2_image = dev->base;
+	ext2_image_size = ext2_sb.blocks_count * ext2_sb.block_size;
+
+	// the group descriptors start in the block after the superblock
+	gd = ext2_image + (ext2_sb.first_data_block + 1) * ext2_sb.block_size;
+	for(i=0;i<ext2_sb.num_groups;i++) {
+		ext2_inode_table[i] = *(uint32_t*)(gd + i*EXT2_GROUP_DESC_SIZE + 8);
+	}
+
+	memset(ext2_icache, 0, sizeof(ext2_icache));
+	memset(ext2_names, 0, sizeof(ext2_names));
+	ext2_names_used = 0;
+	ext2_num_indexed = 0;
+
+	if(!vfs_mount(path, &ext2_vfs_ops)) {
+		return -1;
+	}
+
+	printf("ext2: %d blocks of %d bytes, %d inodes in %d groups\n", ext2_sb.blocks_count, ext2_sb.block_size, ext2_sb.inodes_count, ext2_sb.num_groups);
+	return 0;
+}
+
+/*	ext2_block
+ *   DESCRIPTION: this function finds a block of the file system in memory
+ *   INPUTS: block -- the block number
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: address of the block, NULL if the number is invalid
+ *   SIDE EFFECTS: NONE
+ */
+static uint8_t* ext2_block(uint32_t block) {
+
+	if(!block || block >= ext2_sb.blocks_count) {
+		return NULL;
+	}
+
+	return ext2_image + block * ext2_sb.block_size;
+}
+
+/*	ext2_iget
+ *   DESCRIPTION: this function finds an inode through the inode cache, a miss
+ *				  reads it from the inode table of its group
+ *   INPUTS: ino -- the inode number
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the cached inode, valid until the next ext2_iget, NULL if the
+ *				   number is invalid
+ *   SIDE EFFECTS: cache slot of the inode replaced
+ */
+static ext2_inode_t* ext2_iget(uint32_t ino) {
+	ext2_inode_t* inode;
+	uint32_t group, offset;
+	uint8_t* raw;
+
+	if(!ext2_image || ino == 0 || ino > ext2_sb.inodes_count) {
+		return NULL;
+	}
+
+	inode = &ext2_icache[ino & (EXT2_ICACHE_SIZE - 1)];
+	if(inode->ino == ino) {
+		return inode;
+	}
+
+	group = (ino - 1) / ext2_sb.inodes_per_group;
+	if(group >= ext2_sb.num_groups) {
+		return NULL;
+	}
+	offset = (ino - 1) % ext2_sb.inodes_per_group * ext2_sb.inode_size;
+	if(ext2_inode_table[group] >= ext2_sb.blocks_count ||
+		ext2_inode_table[group] * ext2_sb.block_size + offset + EXT2_GOOD_OLD_INODE_SIZE > ext2_image_size) {
+		return NULL;	// bad inode table
+	}
+	raw = ext2_image + ext2_inode_table[group] * ext2_sb.block_size + offset;
+
+	inode->ino = ino;
+	inode->mode = *(uint16_t*)(raw + 0);
+	inode->size = *(uint32_t*)(raw + 4);
+	memcpy(inode->block, raw + 40, sizeof(inode->block));
+	return inode;
+}
+
+/*	ext2_indirect
+ *   DESCRIPTION: this function reads an entry of an indirect block
+ *   INPUTS: block -- the indirect block
+ *			 index -- index of the entry
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the block number, 0 for a hole or a bad indirect block
+ *   SIDE EFFECTS: NONE
+ */
+static uint32_t ext2_indirect(uint32_t block, uint32_t index) {
+	uint8_t* adr = ext2_block(block);
+
+	return adr ? ((uint32_t*)adr)[index] : 0;
+}
+
+/*	ext2_bmap
+ *   DESCRIPTION: this function finds the block holding a block of a file through
+ *				  the direct, single, double and triple indirect blocks
+ *   INPUTS: inode -- the inode of the file
+ *			 index -- index of the block within the file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the block number, 0 for a hole
+ *   SIDE EFFECTS: NONE
+ */
+static uint32_t ext2_bmap(const ext2_inode_t* inode, uint32_t index) {
+	uint32_t per = ext2_sb.block_size / 4;	// block numbers in an indirect block
+
+	if(index < EXT2_NDIR_BLOCKS) {
+		return inode->block[index];
+	}
+	index -= EXT2_NDIR_BLOCKS;
+
+	if(index < per) {
+		return ext2_indirect(inode->block[EXT2_IND_BLOCK], index);
+	}
+	index -= per;
+
+	if(index < per * per) {
+		return ext2_indirect(ext2_indirect(inode->block[EXT2_DIND_BLOCK], index / per), index % per);
+	}
+	index -= per * per;
+
+	return ext2_indirect(ext2_indirect(ext2_indirect(inode->block[EXT2_TIND_BLOCK],
+		index / (per * per)), index / per % per), index % per);
+}
+
+/*	ext2_read_data
+ *   DESCRIPTION: this function reads data of a file into buf, holes read as zeros
+ *   INPUTS: inode -- the inode of the file
+ *			 offset -- offset to start reading at
+ *			 buf -- pointer to store data into
+ *			 length -- length of bytes to read
+ *   OUTPUTS: data from the file
+ *   RETURN VALUE: number of bytes read, 0 at end of file, -1 with a bad block number
+ *   SIDE EFFECTS: buffer modified
+ */
+static int32_t ext2_read_data(const ext2_inode_t* inode, uint32_t offset, uint8_t* buf, uint32_t length) {
+	uint32_t bs = ext2_sb.block_size;
+	uint32_t chunk, block;
+	uint32_t copied = 0;
+	uint8_t* src;
+
+	if(offset >= inode->size) {
+		return 0;	//end of file reached
+	}
+	if(length > inode->size - offset) {
+		length = inode->size - offset;
+	}
+
+	while(copied < length) {
+		chunk = bs - offset % bs;
+		if(chunk > length - copied) {
+			chunk = length - copied;
+		}
+
+		block = ext2_bmap(inode, offset / bs);
+		if(block == 0) {
+			memset(buf + copied, 0, chunk);		// hole
+		}
+		else {
+			if(!(src = ext2_block(block))) {
+				return -1;	// bad block number
+			}
+			memcpy(buf + copied, src + offset % bs, chunk);
+		}
+
+		offset += chunk;
+		copied += chunk;
+	}
+
+	return copied;
+}
+
+/*	ext2_next_dirent
+ *   DESCRIPTION: this function finds the directory entry at a position of a
+ *				  directory and moves the position past it
+ *   INPUTS: dir -- the inode of the directory
+ *			 pos -- byte offset of the entry, updated
+ *			 name_len -- filled in with the length of the name
+ *   OUTPUTS: pos, name_len
+ *   RETURN VALUE: the entry in the image, NULL at the end of the directory or if
+ *				   the entry is corrupt
+ *   SIDE EFFECTS: NONE
+ */
+static uint8_t* ext2_next_dirent(const ext2_inode_t* dir, uint32_t* pos, uint32_t* name_len) {
+	uint32_t bs = ext2_sb.block_size;
+	uint32_t rec_len;
+	uint8_t* block;
+	uint8_t* dirent;
+
+	if(*pos >= dir->size || !(block = ext2_block(ext2_bmap(dir, *pos / bs)))) {
+		return NULL;
+	}
+
+	dirent = block + *pos % bs;
+	rec_len = *(uint16_t*)(dirent + 4);
+	*name_len = ext2_sb.filetype ? dirent[6] : *(uint16_t*)(dirent + 6);
+	if(rec_len < EXT2_DIRENT_HEADER || *pos % bs + rec_len > bs || EXT2_DIRENT_HEADER + *name_len > rec_len) {
+		return NULL;	// corrupt entry
+	}
+
+	*pos += rec_len;
+	return dirent;
+}
+
+/*	ext2_hash
+ *   DESCRIPTION: this function hashes a name of a directory into the name index
+ *   INPUTS: dir -- inode of the directory
+ *			 name -- the name
+ *			 len -- bytes of the name
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the hash
+ *   SIDE EFFECTS: NONE
+ */
+static uint32_t ext2_hash(uint32_t dir, const uint8_t* name, uint32_t len) {
+	uint32_t hash = 2166136261U ^ (dir * 2654435761U);	// FNV offset basis mixed with the directory
+	uint32_t i;
+
+	for(i=0;i<len;i++) {
+		hash ^= name[i];
+		hash *= 16777619U;		// FNV prime
+	}
+
+	return hash;
+}
+
+/*	ext2_index_dir
+ *   DESCRIPTION: this function adds every name of a directory to the name index,
+ *				  so later lookups in it take one probe instead of a scan
+ *   INPUTS: dir -- the inode of the directory
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the index has no room for the directory
+ *   SIDE EFFECTS: name index updated
+ */
+static int32_t ext2_index_dir(const ext2_inode_t* dir) {
+	uint32_t pos = 0;
+	uint32_t len, hash, slot;
+	uint8_t* dirent;
+
+	if(ext2_num_indexed >= EXT2_MAX_INDEXED_DIRS) {
+		return -1;
+	}
+
+	while((dirent = ext2_next_dirent(dir, &pos, &len))) {
+		if(*(uint32_t*)dirent == 0) {
+			continue;	// unused entry
+		}
+		if(ext2_names_used >= EXT2_HASH_SIZE * 3 / 4) {
+			return -1;	// too full to probe quickly, names added so far stay valid
+		}
+
+		hash = ext2_hash(dir->ino, dirent + EXT2_DIRENT_HEADER, len);
+		for(slot=hash & EXT2_HASH_MASK;ext2_names[slot].dir;slot=(slot+1) & EXT2_HASH_MASK);
+		ext2_names[slot].dir = dir->ino;
+		ext2_names[slot].hash = hash;
+		ext2_names[slot].ino = *(uint32_t*)dirent;
+		ext2_names[slot].dirent = dirent;
+		ext2_names_used++;
+	}
+
+	ext2_indexed[ext2_num_indexed++] = dir->ino;
+	return 0;
+}
+
+/*	ext2_dir_lookup
+ *   DESCRIPTION: this function looks up a name in a directory, through the name
+ *				  index once the directory is in it, by a scan otherwise
+ *   INPUTS: dir -- the inode of the directory
+ *			 name -- the name, not necessarily null terminated
+ *			 len -- bytes of the name
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the inode number of the name, 0 if it is not in the directory
+ *   SIDE EFFECTS: the directory may be added to the name index
+ */
+static uint32_t ext2_dir_lookup(const ext2_inode_t* dir, const uint8_t* name, uint32_t len) {
+	uint32_t i, hash, slot, name_len;
+	uint32_t pos = 0;
+	uint8_t* dirent;
+	ext2_name_t* entry;
+
+	for(i=0;i<ext2_num_indexed && ext2_indexed[i] != dir->ino;i++);
+	if(i < ext2_num_indexed || ext2_index_dir(dir) == 0) {
+		hash = ext2_hash(dir->ino, name, len);
+		for(slot=hash & EXT2_HASH_MASK;ext2_names[slot].dir;slot=(slot+1) & EXT2_HASH_MASK) {
+			entry = &ext2_names[slot];
+			name_len = ext2_sb.filetype ? entry->dirent[6] : *(uint16_t*)(entry->dirent + 6);
+			if(entry->dir == dir->ino && entry->hash == hash && name_len == len &&
+				strncmp((int8_t*)entry->dirent + EXT2_DIRENT_HEADER, (int8_t*)name, len) == 0) {
+				return entry->ino;
+			}
+		}
+		return 0;	// every name of the directory is indexed
+	}
+
+	while((dirent = ext2_next_dirent(dir, &pos, &name_len))) {
+		if(*(uint32_t*)dirent && name_len == len &&
+			strncmp((int8_t*)dirent + EXT2_DIRENT_HEADER, (int8_t*)name, len) == 0) {
+			return *(uint32_t*)dirent;
+		}
+	}
+
+	return 0;
+}
+
+/*	ext2_vnode_lookup
+ *   DESCRIPTION: this function resolves a path below the mount point from the
+ *				  root directory, "." and ".." are ordinary entries in ext2
+ *   INPUTS: path -- the path
+ *			 ino -- filled in with the inode number
+ *			 type -- filled in with DIR_FILE or REG_FILE
+ *   OUTPUTS: ino, type
+ *   RETURN VALUE: 0 on success, -1 if the path does not exist or is not a
+ *				   directory or regular file
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t ext2_vnode_lookup(const uint8_t* path, uint32_t* ino, uint32_t* type) {
+	uint32_t cur = EXT2_ROOT_INO;
+	uint32_t len;
+	ext2_inode_t* inode;
+
+	while(*path != '\0') {
+		if(*path == '/') {
+			path++;
+			continue;
+		}
+
+		for(len=0;path[len] != '\0' && path[len] != '/';len++);
+		if(len > EXT2_NAME_LEN) {
+			return -1;
+		}
+
+		inode = ext2_iget(cur);
+		if(!inode || (inode->mode & EXT2_S_IFMT) != EXT2_S_IFDIR) {
+			return -1;	// a file in the middle of the path
+		}
+		if(!(cur = ext2_dir_lookup(inode, path, len))) {
+			return -1;
+		}
+
+		path += len;
+	}
+
+	if(!(inode = ext2_iget(cur))) {
+		return -1;
+	}
+
+	switch(inode->mode & EXT2_S_IFMT) {
+		case EXT2_S_IFDIR:
+			*type = DIR_FILE;
+			break;
+		case EXT2_S_IFREG:
+			*type = REG_FILE;
+			break;
+		default:
+			return -1;	// links and special files are not supported
+	}
+
+	*ino = cur;
+	return 0;
+}
+
+/*	ext2_vnode_fill
+ *   DESCRIPTION: this function sets up the vnode of an ext2 file or directory
+ *   INPUTS: vnode -- the vnode, ino and type filled in by ext2_vnode_lookup
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the inode is invalid
+ *   SIDE EFFECTS: vnode modified
+ */
+static int32_t ext2_vnode_fill(vnode_t* vnode) {
+	ext2_inode_t* inode = ext2_iget(vnode->ino);
+
+	if(!inode) {
+		return -1;
+	}
+
+	vnode->fops = vnode->type == DIR_FILE ? &ext2_dir_fops : &ext2_fops;
+	vnode->length = inode->size;
+	return 0;
+}
+
+/*	ext2_file_read
+ *   DESCRIPTION: this function reads a file from its file position
+ *   INPUTS: file_desc -- file descriptor of the file
+ *			 buf   -- buffer to write to
+ *			 nbytes -- number of bytes to read
+ *   OUTPUTS: write the file data into buf
+ *   RETURN VALUE: number of bytes read, 0 if end of file reached, -1 on failure
+ *   SIDE EFFECTS: file position updated
+ */
+int32_t ext2_file_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes) {
+	ext2_inode_t* inode;
+	int32_t bytes_read;
+
+	if(!file_desc || file_desc->flags != 1 || !file_desc->vnode || !buf) {
+		return -1;
+	}
+
+	if(file_desc->file_pos >= file_desc->vnode->length) {
+		return 0;	//end of file reached
+	}
+
+	if(!(inode = ext2_iget(file_desc->vnode->ino))) {
+		return -1;
+	}
+
+	bytes_read = ext2_read_data(inode, file_desc->file_pos, buf, nbytes);
+	if(bytes_read > 0) {
+		file_desc->file_pos += bytes_read;
+	}
+
+	return bytes_read;
+}
+
+/*	ext2_dir_read
+ *   DESCRIPTION: this function reads the name of the next entry of a directory,
+ *				  file_pos of the descriptor is the byte offset of the next entry
+ *   INPUTS: file_desc -- file descriptor of the directory
+ *			 buf   -- buffer to write to
+ *			 nbytes -- size of buf
+ *   OUTPUTS: write the name into buf
+ *   RETURN VALUE: number of bytes written, 0 if end of directory reached
+ *   SIDE EFFECTS: buf is modified
+ */
+int32_t ext2_dir_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes) {
+	ext2_inode_t* inode;
+	uint32_t pos, len;
+	uint8_t* dirent;
+
+	if(!file_desc || file_desc->flags != 1 || !file_desc->vnode || !buf) {
+		return -1;
+	}
+
+	if(!(inode = ext2_iget(file_desc->vnode->ino))) {
+		return -1;
+	}
+
+	pos = file_desc->file_pos;
+	while((dirent = ext2_next_dirent(inode, &pos, &len)) && *(uint32_t*)dirent == 0);
+	file_desc->file_pos = pos;
+	if(!dirent) {
+		return 0;	//end of directory reached
+	}
+
+	if(len > nbytes) {
+		len = nbytes;
+	}
+	memcpy(buf, dirent + EXT2_DIRENT_HEADER, len);
+	return len;
+}
+
+/*	ext2_write
+ *   DESCRIPTION: this function will always return -1 since ext2 is mounted read only
+ *   INPUTS: file_desc -- ignored
+ *			 buf -- ignored
+ *			 nbytes -- ignored
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: always return -1
+ *   SIDE EFFECTS: NONE
+ */
+int32_t ext2_write(fd_t* file_desc, const uint8_t* buf, uint32_t nbytes) {
+	return -1;
+}
+
+/*	ext2_close
+ *   DESCRIPTION: this function is called when a file or directory is closed
+ *   INPUTS: file_desc -- the file descriptor
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 on invalid file descriptor
+ *   SIDE EFFECTS: NONE
+ */
+int32_t ext2_close(fd_t* file_desc) {
+
+	if(!file_desc) {
+		return -1;
+	}
+
+	file_desc->fops_p = NULL;
+	file_desc->file_pos = 0;
+	file_desc->flags = 0;
+	return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef _EXT2_H
+#define _EXT2_H
+
+#include "types.h"
+#include "lib.h"
+#include "fs.h"
+#include "vfs.h"
+#include "blkdev.h"
+
+#define EXT2_MOUNT_PATH "/ext2"		// where an ext2 boot module is mounted
+
+/* on disk layout, offsets in bytes */
+#define EXT2_SUPER_OFFSET 1024
+#define EXT2_MAGIC 0xEF53
+#define EXT2_ROOT_INO 2
+#define EXT2_NDIR_BLOCKS 12			// direct blocks in an inode
+#define EXT2_IND_BLOCK 12
+#define EXT2_DIND_BLOCK 13
+#define EXT2_TIND_BLOCK 14
+#define EXT2_N_BLOCKS 15
+#define EXT2_GOOD_OLD_INODE_SIZE 128
+#define EXT2_GROUP_DESC_SIZE 32
+#define EXT2_DIRENT_HEADER 8		// inode, rec_len, name_len, file_type
+#define EXT2_NAME_LEN 255
+
+/* i_mode file types */
+#define EXT2_S_IFMT 0xF000
+#define EXT2_S_IFDIR 0x4000
+#define EXT2_S_IFREG 0x8000
+
+/* incompatible features a read only mount understands, anything else is refused */
+#define EXT2_FEATURE_INCOMPAT_FILETYPE 0x0002	// dirents carry the file type
+#define EXT2_FEATURE_INCOMPAT_FLEX_BG 0x0200		// inode tables may sit outside their group
+#define EXT2_FEATURE_INCOMPAT_SUPP (EXT2_FEATURE_INCOMPAT_FILETYPE | EXT2_FEATURE_INCOMPAT_FLEX_BG)
+
+/* block groups whose inode table address is kept in memory */
+#define EXT2_MAX_GROUPS 128
+
+/* decoded inodes kept in memory, direct mapped by inode number, a power of 2 */
+#define EXT2_ICACHE_SIZE 64
+
+/* name index of the directories looked up so far, open addressing, a power of 2.
+ * a directory too large to fit is searched entry by entry instead */
+#define EXT2_HASH_SIZE 2048
+#define EXT2_HASH_MASK (EXT2_HASH_SIZE - 1)
+#define EXT2_MAX_INDEXED_DIRS 64
+
+/* the fields of the superblock the driver uses */
+typedef struct ext2_super
+{
+	uint32_t inodes_count;
+	uint32_t blocks_count;
+	uint32_t first_data_block;
+	uint32_t block_size;
+	uint32_t blocks_per_group;
+	uint32_t inodes_per_group;
+	uint32_t inode_size;
+	uint32_t num_groups;
+	uint32_t filetype;			// dirents have a file type byte and an 8 bit name length
+} ext2_super_t;
+
+/* an inode as far as a read only driver cares */
+typedef struct ext2_inode
+{
+	uint32_t ino;				// 0 if the cache slot is unused
+	uint32_t mode;
+	uint32_t size;
+	uint32_t block[EXT2_N_BLOCKS];
+} ext2_inode_t;
+
+/* a name of an indexed directory, the name itself is compared in the image */
+typedef struct ext2_name
+{
+	uint32_t dir;				// inode of the directory, 0 if the slot is unused
+	uint32_t hash;
+	uint32_t ino;
+	uint8_t* dirent;			// the directory entry in the image
+} ext2_name_t;
+
+/* the device an ext2 boot module is mounted from */
+extern blkdev_t ext2_ramdisk;
+
+/*checks whether an image starts with an ext2 file system*/
+extern int32_t ext2_probe(uint8_t* image);
+/*mounts an ext2 boot module at EXT2_MOUNT_PATH*/
+extern int32_t ext2_init(uint8_t* image, uint32_t length);
+/*mounts the ext2 file system of a memory resident device*/
+extern int32_t ext2_mount(blkdev_t* dev, const uint8_t* path);
+
+/*file operations of ext2 files and directories*/
+extern int32_t ext2_file_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes);
+extern int32_t ext2_dir_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes);
+extern int32_t ext2_write(fd_t* file_desc, const uint8_t* buf, uint32_t nbytes);
+extern int32_t ext2_close(fd_t* file_desc);
+
+#endif
@@ -0,0 +1,245 @@
+#include "frame.h"
+#include "lib.h"
+
+/*state of every frame: FRAME_FREE | order for the first frame of a free block,
+ *FRAME_ALLOC | order for the first frame of an allocated block, 0 otherwise*/
+static uint8_t frame_state[FRAME_COUNT];
+
+/*free blocks of each order, doubly linked through the index of their first frame*/
+static uint16_t frame_next[FRAME_COUNT];
+static uint16_t frame_prev[FRAME_COUNT];
+static uint16_t frame_free_list[FRAME_MAX_ORDER+1];
+
+uint32_t frames_free = 0;
+
+static void frame_seed(uint32_t start, uint32_t end, multiboot_info_t* mbi);
+static void frame_merge(uint32_t idx, uint32_t order);
+
+/*
+* frame_push
+*	description: put a free block on the free list of its order
+*	input: idx -- index of the first frame of the block
+*		   order -- order of the block
+*	output: none
+*	return: none
+*	side effect: free list and frame state updated
+*/
+static void frame_push(uint32_t idx, uint32_t order) {
+	frame_state[idx] = FRAME_FREE | order;
+	frame_prev[idx] = FRAME_NONE;
+	frame_next[idx] = frame_free_list[order];
+	if(frame_free_list[order] != FRAME_NONE) {
+		frame_prev[frame_free_list[order]] = idx;
+	}
+	frame_free_list[order] = idx;
+}
+
+/*
+* frame_unlink
+*	description: take a free block off the free list of its order
+*	input: idx -- index of the first frame of the block
+*		   order -- order of the block
+*	output: none
+*	return: none
+*	side effect: free list and frame state updated
+*/
+static void frame_unlink(uint32_t idx, uint32_t order) {
+	if(frame_prev[idx] != FRAME_NONE) {
+		frame_next[frame_prev[idx]] = frame_next[idx];
+	}
+	else {
+		frame_free_list[order] = frame_next[idx];
+	}
+	if(frame_next[idx] != FRAME_NONE) {
+		frame_prev[frame_next[idx]] = frame_prev[idx];
+	}
+	frame_state[idx] = 0;
+}
+
+/*
+* frame_init
+*	description: hand the allocator every frame between FRAME_BASE and FRAME_LIMIT
+*				 that the memory map marks usable, except those holding boot
+*				 modules. without a memory map, mem_upper is used
+*	input: mbi -- the multiboot information
+*	output: none
+*	return: none
+*	side effect: free lists built
+*/
+void frame_init(multiboot_info_t* mbi) {
+	memory_map_t* mmap;
+	uint32_t i, start, end;
+
+	for(i = 0; i <= FRAME_MAX_ORDER; i++) {
+		frame_free_list[i] = FRAME_NONE;
+	}
+	memset(frame_state, 0, sizeof(frame_state));
+	frames_free = 0;
+
+	if(mbi->flags & (1 << 6)) {
+		for(mmap = (memory_map_t*) mbi->mmap_addr;
+				(uint32_t) mmap < mbi->mmap_addr + mbi->mmap_length;
+				mmap = (memory_map_t*) ((uint32_t) mmap + mmap->size + sizeof(mmap->size))) {
+			if(mmap->type != 1 || mmap->base_addr_high) {
+				continue;	// reserved, or above 4GB
+			}
+			start = mmap->base_addr_low;
+			end = start + mmap->length_low;
+			if(mmap->length_high || end < start) {
+				end = 0xFFFFFFFF;	// runs past 4GB
+			}
+			frame_seed(start, end, mbi);
+		}
+	}
+	else if(mbi->flags & (1 << 0)) {
+		frame_seed(0x100000, 0x100000 + mbi->mem_upper * 1024, mbi);
+	}
+
+	printf("%d kB of memory for programs\n", frames_free * (FRAME_SIZE / 1024));
+}
+
+/*
+* frame_seed
+*	description: free the whole frames of a usable range of memory that lie in
+*				 the managed region and hold no boot module
+*	input: start, end -- the range
+*		   mbi -- the multiboot information, for the modules
+*	output: none
+*	return: none
+*	side effect: frames freed
+*/
+static void frame_seed(uint32_t start, uint32_t end, multiboot_info_t* mbi) {
+	module_t* mod;
+	uint32_t addr, i;
+
+	if(start < FRAME_BASE) {
+		start = FRAME_BASE;
+	}
+	if(end > FRAME_LIMIT) {
+		end = FRAME_LIMIT;
+	}
+	start = (start + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+
+	for(addr = start; addr < end && end - addr >= FRAME_SIZE; addr += FRAME_SIZE) {
+		if(mbi->flags & (1 << 3)) {
+			mod = (module_t*) mbi->mods_addr;
+			for(i = 0; i < mbi->mods_count; i++) {
+				if(addr < mod[i].mod_end && addr + FRAME_SIZE > mod[i].mod_start) {
+					break;
+				}
+			}
+			if(i < mbi->mods_count) {
+				continue;	// holds part of a module
+			}
+		}
+		frame_merge((addr - FRAME_BASE) / FRAME_SIZE, 0);
+	}
+}
+
+/*
+* alloc_frames
+*	description: allocate 2^order contiguous frames, aligned to their size. the
+*				 smallest free block that is large enough is split in halves
+*	input: order -- 0 for a single frame, up to FRAME_MAX_ORDER
+*	output: none
+*	return: physical address of the first frame
+*			0 if no block is large enough
+*	side effect: frames_free updated
+*/
+uint32_t alloc_frames(uint32_t order) {
+	uint32_t flags;
+	uint32_t idx, cur;
+
+	if(order > FRAME_MAX_ORDER) {
+		return 0;
+	}
+
+	cli_and_save(flags);
+
+	for(cur = order; cur <= FRAME_MAX_ORDER && frame_free_list[cur] == FRAME_NONE; cur++);
+	if(cur > FRAME_MAX_ORDER) {
+		restore_flags(flags);
+		return 0;	// out of memory
+	}
+
+	idx = frame_free_list[cur];
+	frame_unlink(idx, cur);
+
+	// the upper halves go back on the free lists
+	while(cur > order) {
+		cur--;
+		frame_push(idx + (1 << cur), cur);
+	}
+
+	frame_state[idx] = FRAME_ALLOC | order;
+	frames_free -= 1 << order;
+
+	restore_flags(flags);
+	return FRAME_BASE + idx * FRAME_SIZE;
+}
+
+/*
+* free_frames
+*	description: give back a block from alloc_frames, merging it with its free
+*				 buddy as long as there is one
+*	input: addr -- physical address returned by alloc_frames
+*		   order -- order it was allocated with
+*	output: none
+*	return: none
+*	side effect: frames_free updated. a frame that is not the start of an
+*				 allocated block of that order is left alone and reported
+*/
+void free_frames(uint32_t addr, uint32_t order) {
+	uint32_t flags;
+	uint32_t idx;
+
+	if(addr < FRAME_BASE || addr >= FRAME_LIMIT || (addr & (FRAME_SIZE - 1)) || order > FRAME_MAX_ORDER) {
+		return;
+	}
+
+	idx = (addr - FRAME_BASE) / FRAME_SIZE;
+	if((idx & ((1 << order) - 1)) || idx + (1 << order) > FRAME_COUNT) {
+		return;		// not the start of a block of that order
+	}
+
+	cli_and_save(flags);
+
+	if(frame_state[idx] != (FRAME_ALLOC | order)) {
+		restore_flags(flags);
+		printf("free_frames: %x is not an allocated block of order %d\n", addr, order);
+		return;		// already free, inside a block or allocated with another order
+	}
+
+	frame_merge(idx, order);
+	restore_flags(flags);
+}
+
+/*
+* frame_merge
+*	description: put a block on the free lists, merging it with its free buddy
+*				 as long as there is one
+*	input: idx -- index of the first frame of the block
+*		   order -- order of the block
+*	output: none
+*	return: none
+*	side effect: frames_free updated, called with interrupts disabled
+*/
+static void frame_merge(uint32_t idx, uint32_t order) {
+	uint32_t buddy;
+
+	frames_free += 1 << order;
+
+	for(; order < FRAME_MAX_ORDER; order++) {
+		buddy = idx ^ (1 << order);
+		if(buddy >= FRAME_COUNT || frame_state[buddy] != (FRAME_FREE | order)) {
+			break;
+		}
+		frame_unlink(buddy, order);
+		frame_state[idx] = 0;
+		if(buddy < idx) {
+			idx = buddy;
+		}
+	}
+
+	frame_push(idx, order);
+}
@@ -0,0 +1,38 @@
+#ifndef __FRAME_H
+#define __FRAME_H
+
+#include "types.h"
+#include "multiboot.h"
+
+/* physical 4kB frames for program pages, handed out by a buddy allocator.
+ * frames start where the kernel's 4MB page ends and are managed up to
+ * FRAME_LIMIT, memory above it is left unused */
+#define FRAME_SIZE 4096
+#define FRAME_BASE 0x800000
+#define FRAME_LIMIT 0x10000000
+#define FRAME_COUNT ((FRAME_LIMIT - FRAME_BASE) / FRAME_SIZE)
+#define FRAME_MAX_ORDER 10			// largest block is 2^10 frames, 4MB
+
+/* the kernel reaches frames through a supervisor only mapping of the managed
+ * region, a frame at physical addr is at FRAME_MAP_ADR + addr. the mapping
+ * starts at the kernel's 4MB page, so boot modules that GRUB put past the
+ * identity mapped 8MB are reached through it too */
+#define FRAME_MAP_START 0x400000
+#define FRAME_MAP_ADR 0xC0000000
+#define FRAME_VIRT(addr) ((void*) ((uint32_t) (addr) + FRAME_MAP_ADR))
+#define FRAME_PHYS(ptr) ((uint32_t) (ptr) - FRAME_MAP_ADR)
+
+#define FRAME_FREE 0x80				// state of the first frame of a free block, with its order
+#define FRAME_ALLOC 0x40			// state of the first frame of an allocated block, with its order
+#define FRAME_NONE 0xFFFF			// end of a free list
+
+/*seeds the allocator with the usable memory of the multiboot memory map*/
+extern void frame_init(multiboot_info_t* mbi);
+/*allocates 2^order contiguous frames*/
+extern uint32_t alloc_frames(uint32_t order);
+/*gives back frames from alloc_frames*/
+extern void free_frames(uint32_t addr, uint32_t order);
+
+/*frames not allocated*/
+extern uint32_t frames_free;
+#endif
@@ -1,5 +1,10 @@
 #include "fs.h"
 #include "syscalls.h"
+#include "bcache.h"
+#include "blkdev.h"
+#include "lzdisk.h"
+#include "dcache.h"
+#include "vfs.h"
 
 uint32_t* fs_base_adr = 0;	// the start address of the file system
 
@@ -8,9 +13,47 @@ uint32_t num_dentries;
 uint32_t num_index_nodes;
 uint32_t num_data_blocks;
 
-/* directory buffer, length and offset */
-uint8_t dir_buf[MAX_BUF_SIZE];
-uint32_t dir_length;
+/* filename index, an open addressing hash table of dentry slots built once at fs_init.
+ * the name hash and length of each slot are kept so a probe only calls strncmp on a real match */
+uint8_t dentry_hash[DENTRY_HASH_SIZE];
+uint32_t dentry_name_hash[MAX_DENTRIES];
+uint8_t dentry_name_len[MAX_DENTRIES];
+
+/* free maps, a set bit means the inode or data block is in use. they are
+ * rebuilt from the dentries and inodes at every fs_init */
+uint8_t inode_bitmap[FS_MAX_INODES/8];
+uint8_t block_bitmap[FS_MAX_DATA_BLOCKS/8];
+uint32_t fs_writable;
+
+/* metadata of the index nodes, valid for the first FS_MAX_INODES. larger images
+ * read the rest with the checks made on every access */
+fs_inode_meta_t fs_inode_meta[FS_MAX_INODES];
+
+/* the device the file system is mounted from, the boot module image by default */
+blkdev_t fs_ramdisk;
+blkdev_t fs_lzdisk;		// the boot module image when it is compressed
+blkdev_t* fs_dev = NULL;
+uint32_t fs_data_start;		// device block number of data block 0
+
+/* boot block and inodes of a device that is not memory resident, read in at mount */
+static uint8_t fs_meta[FS_META_MAX_BLOCKS*BLOCK_SIZE];
+
+/* bumped whenever the blocks of a file change, to drop the translation caches of open files */
+uint32_t fs_map_gen = 0;
+
+/* where the file system is mounted in the vfs */
+static int32_t fs_vnode_lookup(const uint8_t* path, uint32_t* ino, uint32_t* type);
+static int32_t fs_vnode_fill(vnode_t* vnode);
+vfs_ops_t fs_vfs_ops = { fs_vnode_lookup, fs_vnode_fill, fs_create, NULL, NULL };
+
+static void index_dentry(uint32_t i);
+static int32_t read_file_data (uint32_t* node, xlate_t* xlate, uint32_t offset, uint8_t* buf, uint32_t length);
+static void file_readahead (fd_t* file_desc, uint32_t offset, int32_t bytes_read);
+static uint32_t is_subdir (const dentry_t* dentry);
+static uint32_t hash_fname(const uint8_t* fname, uint32_t* len);
+static fs_inode_meta_t* fs_node_meta(uint32_t* node);
+static void fs_meta_add_block(uint32_t* node, uint32_t index, uint32_t block);
+static void fs_meta_set_length(uint32_t* node);
 
 uint32_t get_file_length(unsigned int inode){
 	uint32_t* node = (uint32_t*) ((uint8_t *)fs_base_adr + (inode+1)*BLOCK_SIZE);	//index nodes start at 1st entry in file system
@@ -18,10 +61,194 @@ uint32_t get_file_length(unsigned int inode){
    	return file_length;
 }
 
+/*	fs_read_block
+ *   DESCRIPTION: this function reads part of a data block, straight from a memory
+ *				  resident device unless a newer copy is in the block cache
+ *   INPUTS: block -- the data block number
+ *			 offset -- offset within the block
+ *			 buf -- buffer to write to
+ *			 length -- number of bytes to read
+ *   OUTPUTS: buf
+ *   RETURN VALUE: 0 on success, -1 with bad data block number or if the device failed
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t fs_read_block(uint32_t block, uint32_t offset, void* buf, uint32_t length) {
+	uint8_t* src;
+
+	if(block >= num_data_blocks) {
+		return -1;	//bad data block number
+	}
+
+	src = blkdev_direct(fs_dev, fs_data_start + block);
+	if(!src || bcache_dirty_count) {
+		if(bcache_read(fs_data_start + block, offset, buf, length, src ? BCACHE_CACHED : BCACHE_LOAD) == 0) {
+			return 0;
+		}
+		if(!src) {
+			return -1;	// device failed
+		}
+	}
+
+	bcache_stats.direct++;
+	memcpy(buf, src + offset, length);
+	return 0;
+}
+
+/*	fs_bmap
+ *   DESCRIPTION: this function finds the data block holding a block of a file.
+ *				  blocks past the direct ones are found through the indirect
+ *				  blocks. with an open file, a run of block numbers is read from
+ *				  the indirect block at once into the translation cache of its
+ *				  vnode, so sequential reads only walk the indirect blocks once
+ *				  per run
+ *   INPUTS: node -- the index node of the file
+ *			 xlate -- the translation cache to use, or NULL
+ *			 index -- index of the block within the file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the data block number, FS_BAD_BLOCK if past the end of file or
+ *				   an indirect block cannot be read
+ *   SIDE EFFECTS: xlate refilled
+ */
+static uint32_t fs_bmap(uint32_t* node, xlate_t* xlate, uint32_t index) {
+	uint32_t blocks = (node[0] + BLOCK_SIZE - 1) / BLOCK_SIZE;	// blocks in the file
+	uint32_t rel = index - INODE_DIRECT_BLOCKS;	// index among the indirect blocks
+	uint32_t ind;			// indirect block holding the block number
+	uint32_t count = 1;		// block numbers to read from it
+	uint32_t block;
+
+	if(index >= blocks) {
+		return FS_BAD_BLOCK;	// past the end of file
+	}
+
+	if(index < INODE_DIRECT_BLOCKS) {
+		return node[index+1];
+	}
+
+	if(xlate && xlate->gen == fs_map_gen &&
+		index >= xlate->first && index - xlate->first < xlate->count) {
+		return xlate->block[index - xlate->first];
+	}
+
+	if(rel < INDIRECT_ENTRIES) {
+		ind = node[INODE_INDIRECT];
+	}
+	else {
+		rel -= INDIRECT_ENTRIES;
+		if(fs_read_block(node[INODE_DINDIRECT], rel / INDIRECT_ENTRIES * 4, &ind, 4) == -1) {
+			return FS_BAD_BLOCK;
+		}
+		rel %= INDIRECT_ENTRIES;
+	}
+
+	if(!xlate) {
+		if(fs_read_block(ind, rel * 4, &block, 4) == -1) {
+			return FS_BAD_BLOCK;
+		}
+		return block;
+	}
+
+	// fill the cache up to the end of the indirect block or of the file
+	count = VN_XLATE_SIZE;
+	if(count > INDIRECT_ENTRIES - rel) {
+		count = INDIRECT_ENTRIES - rel;
+	}
+	if(count > blocks - index) {
+		count = blocks - index;
+	}
+
+	xlate->count = 0;
+	if(fs_read_block(ind, rel * 4, xlate->block, count * 4) == -1) {
+		return FS_BAD_BLOCK;
+	}
+	xlate->gen = fs_map_gen;
+	xlate->first = index;
+	xlate->count = count;
+
+	return xlate->block[0];
+}
+
+/*	get_block_adr
+ *   DESCRIPTION: this function finds where a data block of a file sits in memory
+ *   INPUTS: inode -- the index node number of the file
+ *			 block_index -- index of the block within the file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: kernel address of the data block, NULL if past the end of file or
+ *				   invalid. it is the device's base plus the block offset, not a
+ *				   physical address, so mapping it for a program needs a conversion
+ *   SIDE EFFECTS: NONE
+ */
+uint8_t* get_block_adr(uint32_t inode, uint32_t block_index) {
+
+	uint32_t* node;
+	uint32_t block_number;
+
+	if(!fs_base_adr || inode >= num_index_nodes || inode >= FS_MAX_INODES) {
+		return NULL;	// not initialized, invalid, or its mappings cannot be counted
+	}
+
+	if(fs_inode_meta[inode].flags & FS_INODE_CONTIG) {
+		if(block_index >= fs_inode_meta[inode].num_blocks || !(fs_inode_meta[inode].flags & FS_INODE_VALID)) {
+			return NULL;	// past the end of file or rejected at mount
+		}
+		return blkdev_direct(fs_dev, fs_data_start + fs_inode_meta[inode].first_block + block_index);
+	}
+
+	node = (uint32_t*) ((uint8_t *)fs_base_adr + (inode+1)*BLOCK_SIZE);	//index nodes start at 1st entry in file system
+	block_number = fs_bmap(node, NULL, block_index);
+	if(block_number >= num_data_blocks) {
+		return NULL;	// past the end of file or bad data block number
+	}
+
+	return blkdev_direct(fs_dev, fs_data_start + block_number);
+}
+
+/*	fs_map_get
+ *   DESCRIPTION: this function counts a mapping of the data blocks of a file, made
+ *				  from the addresses get_block_adr gives. the blocks of a mapped
+ *				  file are not freed until every mapping is dropped
+ *   INPUTS: inode -- the index node number of the file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the index node is invalid
+ *   SIDE EFFECTS: fs_inode_meta updated
+ */
+int32_t fs_map_get(uint32_t inode) {
+	uint32_t flags;
+
+	if(inode >= num_index_nodes || inode >= FS_MAX_INODES) {
+		return -1;	// get_block_adr gives no address for it either
+	}
+
+	cli_and_save(flags);
+	fs_inode_meta[inode].maps++;
+	restore_flags(flags);
+	return 0;
+}
+
+/*	fs_map_put
+ *   DESCRIPTION: this function drops a mapping counted by fs_map_get
+ *   INPUTS: inode -- the index node number of the file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: fs_inode_meta updated
+ */
+void fs_map_put(uint32_t inode) {
+	uint32_t flags;
+
+	if(inode >= num_index_nodes || inode >= FS_MAX_INODES) {
+		return;
+	}
+
+	cli_and_save(flags);
+	if(fs_inode_meta[inode].maps) {
+		fs_inode_meta[inode].maps--;
+	}
+	restore_flags(flags);
+}
+
 /*	fs_init
  *   DESCRIPTION: this function will initialize the file system
- *   INPUTS: adr -- the first address of the file system loaded in memory
-*
+ *   INPUTS: adr -- the first address of the file system loaded in memory, either
+ *			 the plain image or a compressed one starting with LZ_MAGIC
  *   OUTPUTS: NONE
  *   RETURN VALUE: NONE
  *   SIDE EFFECTS: fs_base_adr and num_xxx updated 
@@ -30,17 +257,110 @@ void fs_init (uint32_t* adr) {
 	if(!adr) {
 		//test
 		printf("file system pointer is invalid"); 
+		return;
+	}
+
+	// a compressed image is decompressed a block at a time as it is read
+	if(adr[0] == LZ_MAGIC) {
+		if(lzdisk_init(&fs_lzdisk, (uint8_t*)adr) == -1 || fs_mount(&fs_lzdisk) == -1) {
+			printf("compressed file system image is invalid\n");
+		}
+		return;
 	}
 
-	fs_base_adr = adr;	// store the start address 
+	// the image is the boot block, the index nodes then the data blocks
+	ramdisk_init(&fs_ramdisk, (uint8_t*)adr, 1 + adr[1] + adr[2]);
+	fs_mount(&fs_ramdisk);
+}
+
+/*	fs_mount
+ *   DESCRIPTION: this function mounts the file system stored on a block device. the
+ *				  boot block and index nodes are used in place on memory resident
+ *				  devices and read into fs_meta on others, data blocks go through
+ *				  the block cache
+ *   INPUTS: dev -- the device
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the device cannot be read or has too many
+ *				   index nodes to keep in memory
+ *   SIDE EFFECTS: fs_base_adr and num_xxx updated, block cache reset, mounted
+ *				   at the root of the vfs
+ */
+int32_t fs_mount(blkdev_t* dev) {
+	uint32_t i;
+
+	if(!dev) {
+		return -1;
+	}
+
+	if(dev->base) {
+		fs_base_adr = (uint32_t*)dev->base;	// used in place
+	}
+	else {
+		if(blkdev_rw(dev, BLK_READ, 0, fs_meta) == -1) {
+			return -1;	// cannot read the boot block
+		}
+		if(((uint32_t*)fs_meta)[1] + 1 > FS_META_MAX_BLOCKS) {
+			return -1;	// index nodes do not fit in fs_meta
+		}
+		if(1 + ((uint32_t*)fs_meta)[1] + ((uint32_t*)fs_meta)[2] > dev->num_blocks) {
+			return -1;	// not a file system, or larger than the device
+		}
+		for(i=1;i<=((uint32_t*)fs_meta)[1];i++) {
+			if(blkdev_rw(dev, BLK_READ, i, fs_meta + i*BLOCK_SIZE) == -1) {
+				return -1;	// cannot read an index node
+			}
+		}
+		fs_base_adr = (uint32_t*)fs_meta;
+	}
+
+	fs_dev = dev;
 	
 	/* get the infos from the boot lock*/
 	num_dentries = fs_base_adr[0];
 	num_index_nodes =fs_base_adr[1];
 	num_data_blocks = fs_base_adr[2];
 
+	// the boot block cannot hold more dentries than this
+	if(num_dentries > MAX_DENTRIES) {
+		num_dentries = MAX_DENTRIES;
+	}
+
+	// data blocks follow the index nodes, indirect blocks are read through the cache
+	fs_data_start = num_index_nodes + 1;
+	bcache_init(dev);
+	dcache_reset();
+	vfs_mount((uint8_t*)"/", &fs_vfs_ops);
+
+	build_dentry_index();
+	build_inode_meta();
+	build_free_maps();
+	if(dev->read_only || (fs_base_adr[FS_FLAGS_WORD] & FS_SHARED_BLOCKS)) {
+		fs_writable = 0;	// a write to a shared block would change every file using it
+	}
+
 	//test
 	printf("num_dentries: %d, num_index_nodes: %d, num_data_blocks: %d \n",num_dentries,num_index_nodes,num_data_blocks); 
+	return 0;
+}
+
+/*	fs_meta_dirty
+ *   DESCRIPTION: this function records a change to the boot block or an index node.
+ *				  memory resident devices are changed in place, on other devices the
+ *				  bytes are written through the block cache
+ *   INPUTS: adr -- the changed bytes, within one block of fs_base_adr
+ *			 length -- number of changed bytes
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: block cache updated
+ */
+static void fs_meta_dirty(void* adr, uint32_t length) {
+	uint32_t offset = (uint32_t)adr - (uint32_t)fs_base_adr;
+
+	if(fs_dev->base) {
+		return;		// already changed in place
+	}
+
+	bcache_write(offset / BLOCK_SIZE, offset % BLOCK_SIZE, (uint8_t*)adr, length, length == BLOCK_SIZE ? BCACHE_ZERO : BCACHE_LOAD);
 }
 
 /*	file_open
@@ -48,25 +368,91 @@ void fs_init (uint32_t* adr) {
  *   INPUTS: fname -- file name
  *   OUTPUTS: NONE
  *   RETURN VALUE: 0 if is file type, -1 if type is invalid
- *   SIDE EFFECTS: NONE
+ *   SIDE EFFECTS: file_desc modified
  */
 int32_t file_open (fd_t*  file_desc, const uint8_t* fname) {
 
-	dentry_t f_entry;
-	// check if file existes and is regular file
-	if(read_dentry_by_name(fname,&f_entry) == 0 ) {
-		if(f_entry.type == REG_FILE && file_desc != NULL) {
+	if(vfs_open(file_desc, fname) == -1) {
+		return -1; // file does not exist
+	}
 
-			file_desc->fops_p = &file_fops; // in syscall
-			file_desc->inode_p = (uint32_t*) ((uint8_t *)fs_base_adr + (f_entry.inode+1)*BLOCK_SIZE);
-			file_desc->file_pos = 0;	   
-			file_desc->flags = 1;
+	if(file_desc->vnode->type != REG_FILE) {
+		vfs_close(file_desc);
+		return -1; // not a regular file
+	}
+
+	return 0;
+}
+
+/*	fs_vnode_lookup
+ *   DESCRIPTION: this function resolves a path of the file system for the vfs. the
+ *				  root directory has no index node and is VFS_ROOT_INO
+ *   INPUTS: path -- the path
+ *			 ino -- filled in with the index node number
+ *			 type -- filled in with the type of the file
+ *   OUTPUTS: ino, type
+ *   RETURN VALUE: 0 on success, -1 with non-existent file name
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t fs_vnode_lookup(const uint8_t* path, uint32_t* ino, uint32_t* type) {
+
+	dentry_t d_entry;
 
+	if(read_dentry_by_name(path, &d_entry) == -1) {
+		return -1;
+	}
+
+	*type = d_entry.type;
+	*ino = d_entry.inode;
+	if(d_entry.type == DIR_FILE && !is_subdir(&d_entry)) {
+		*ino = VFS_ROOT_INO;
+	}
+	return 0;
+}
+
+/*	fs_vnode_fill
+ *   DESCRIPTION: this function sets up a new vnode of the file system, caching the
+ *				  index node and length of a file or subdirectory. the rtc dentry
+ *				  of old images opens the same device as /dev/rtc
+ *   INPUTS: vnode -- the vnode, ino and type filled in by fs_vnode_lookup
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the dentry is invalid
+ *   SIDE EFFECTS: vnode modified
+ */
+static int32_t fs_vnode_fill(vnode_t* vnode) {
+
+	switch(vnode->type) {
+		case RTC_FILE:
+			vnode->fops = &rtc_fops;
+			vnode->open = (int32_t (*)(fd_t*)) rtc_open;
 			return 0;
-		}
+
+		case DIR_FILE:
+			vnode->fops = &dir_fops;
+			if(vnode->ino == VFS_ROOT_INO) {
+				return 0;	// the boot block, nothing to cache
+			}
+			break;
+
+		case REG_FILE:
+			vnode->fops = &file_fops;
+			break;
+
+		default:
+			return -1;	// invalid type
+	}
+
+	if(vnode->ino >= num_index_nodes) {
+		return -1;	// invalid index node number
+	}
+	if(vnode->ino < FS_MAX_INODES && !(fs_inode_meta[vnode->ino].flags & FS_INODE_VALID)) {
+		return -1;	// rejected at mount
 	}
 
-	return -1; // file does not exist or not a regular file
+	//index nodes start at 1st entry in file system
+	vnode->node = (uint32_t*) ((uint8_t *)fs_base_adr + (vnode->ino+1)*BLOCK_SIZE);
+	vnode->length = vnode->node[0];
+	return 0;
 }
 
 /*	dir_read
@@ -80,22 +466,684 @@ int32_t file_open (fd_t*  file_desc, const uint8_t* fname) {
  */
 int32_t file_read(fd_t*  file_desc, uint8_t* buf, uint32_t nbytes) {
 
-	uint32_t node;
-	uint32_t bytes_read;
+	int32_t bytes_read;
+	uint32_t offset;
 
-	if( !file_desc || file_desc->flags != 1 || !file_desc->inode_p) {
+	if( !file_desc || file_desc->flags != 1 || !file_desc->vnode || !file_desc->vnode->node) {
 		return -1;	// file not in use or file is a directorys
 	}
 
-	node = (uint32_t)(( (uint32_t)file_desc->inode_p - (uint32_t)fs_base_adr) / BLOCK_SIZE -1); // index of inode 
-	bytes_read = read_data (node, file_desc->file_pos, buf, nbytes);	//read data from file
-
-	file_desc->file_pos += bytes_read;	//update the file position
-
-	return bytes_read;
+	offset = file_desc->file_pos;
+	if(offset >= file_desc->vnode->length) {
+		return 0;	//end of file reached
+	}
+	bytes_read = read_file_data (file_desc->vnode->node, &file_desc->vnode->xlate, offset, buf, nbytes);	//read data from file
+
+	if(bytes_read > 0) {
+		file_desc->file_pos += bytes_read;	//update the file position
+		file_readahead(file_desc, offset, bytes_read);
+	}
+
+	return bytes_read;
+}
+
+/*	file_readahead
+ *   DESCRIPTION: this function starts reading the blocks after a sequential read
+ *				  into the block cache, so the next read finds them there. a read
+ *				  that starts where the last one ended doubles the window, any
+ *				  other read resets it. memory resident devices need no read ahead
+ *   INPUTS: file_desc -- the open file
+ *			 offset -- where the read started
+ *			 bytes_read -- number of bytes read
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: device reads queued, clean cached blocks may be evicted
+ */
+static void file_readahead (fd_t* file_desc, uint32_t offset, int32_t bytes_read) {
+
+	vnode_t* vnode = file_desc->vnode;
+	uint32_t next = (offset + bytes_read + BLOCK_SIZE - 1) / BLOCK_SIZE;	// first block not read
+	uint32_t blocks = (vnode->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	uint32_t end, block_number;
+
+	if(offset != file_desc->ra_pos) {
+		file_desc->ra_window = 0;		// seek, not a stream any more
+		file_desc->ra_end = 0;
+	}
+	else if(file_desc->ra_window < RA_MIN_WINDOW) {
+		file_desc->ra_window = RA_MIN_WINDOW;
+	}
+	else if(file_desc->ra_window < RA_MAX_WINDOW) {
+		file_desc->ra_window *= 2;
+	}
+	file_desc->ra_pos = offset + bytes_read;
+
+	if(!file_desc->ra_window || fs_dev->base) {
+		return;
+	}
+
+	end = next + file_desc->ra_window;
+	if(end > blocks) {
+		end = blocks;
+	}
+	if(next < file_desc->ra_end) {
+		next = file_desc->ra_end;		// requested by an earlier read
+	}
+
+	for(;next<end;next++) {
+		block_number = fs_bmap(vnode->node, &vnode->xlate, next);
+		if(block_number >= num_data_blocks || bcache_prefetch(fs_data_start + block_number) == -1) {
+			break;		// no room, the reader loads the rest itself
+		}
+	}
+	file_desc->ra_end = next;
+}
+
+/*	file_pread
+ *   DESCRIPTION: this function reads the file at the given offset without
+ *				  touching the file position
+ *   INPUTS: file_desc -- file descriptor of the file
+ *			 buf   -- buffer to write to
+ *			 nbytes -- number of bytes to read
+ *			 offset -- offset in the file to read from
+ *   OUTPUTS: write the file data into buf
+ *   RETURN VALUE: number of bytes read, 0 if end of file reached, -1 on failure
+ *   SIDE EFFECTS: buf is modified
+ */
+int32_t file_pread(fd_t* file_desc, uint8_t* buf, uint32_t nbytes, uint32_t offset) {
+
+	if( !file_desc || file_desc->flags != 1 || !file_desc->vnode || !file_desc->vnode->node) {
+		return -1;	// file not in use or file is a directory
+	}
+
+	return read_file_data (file_desc->vnode->node, &file_desc->vnode->xlate, offset, buf, nbytes);
+}
+
+/*	alloc_block
+ *   DESCRIPTION: this function takes a free data block from the block bitmap
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the data block number, -1 if the file system is full
+ *   SIDE EFFECTS: block_bitmap updated
+ */
+static int32_t alloc_block() {
+	uint32_t i;
+
+	for(i=0;i<num_data_blocks;i++) {
+		if(block_bitmap[i / 8] == 0xFF) {
+			i += 7;	// skip a full byte
+			continue;
+		}
+		if(!(block_bitmap[i / 8] & (1 << (i % 8)))) {
+			block_bitmap[i / 8] |= 1 << (i % 8);
+			return i;
+		}
+	}
+
+	return -1;	// no free data block
+}
+
+/*	free_block
+ *   DESCRIPTION: this function returns a data block to the block bitmap
+ *   INPUTS: block -- the data block number
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: block_bitmap updated, cached copy dropped
+ */
+static void free_block(uint32_t block) {
+	if(block < num_data_blocks) {
+		bcache_invalidate(fs_data_start + block);
+		block_bitmap[block / 8] &= ~(1 << (block % 8));
+	}
+}
+
+/*	alloc_zero_block
+ *   DESCRIPTION: this function takes a free data block and fills it with zeros
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the data block number, -1 if the file system is full
+ *   SIDE EFFECTS: block_bitmap updated
+ */
+static int32_t alloc_zero_block() {
+	int32_t block = alloc_block();
+
+	if(block != -1) {
+		bcache_write(fs_data_start + block, 0, NULL, BLOCK_SIZE, BCACHE_ZERO);
+	}
+	return block;
+}
+
+/*	fs_set_bmap
+ *   DESCRIPTION: this function records the data block of the next block of a
+ *				  file, allocating the indirect blocks on the first entry that
+ *				  needs them. blocks are always added in order
+ *   INPUTS: node -- the index node of the file
+ *			 index -- index of the block within the file, the current block count
+ *			 block -- the data block number
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if no indirect block can be allocated
+ *   SIDE EFFECTS: node or indirect blocks updated
+ */
+static int32_t fs_set_bmap(uint32_t* node, uint32_t index, uint32_t block) {
+	int32_t ind;
+	uint32_t rel;
+
+	if(index < INODE_DIRECT_BLOCKS) {
+		node[index+1] = block;
+		return 0;
+	}
+
+	rel = index - INODE_DIRECT_BLOCKS;
+	if(rel < INDIRECT_ENTRIES) {
+		if(rel == 0) {
+			if((ind = alloc_zero_block()) == -1) {
+				return -1;
+			}
+			node[INODE_INDIRECT] = ind;
+		}
+		ind = node[INODE_INDIRECT];
+	}
+	else {
+		rel -= INDIRECT_ENTRIES;
+		if(rel == 0) {
+			if((ind = alloc_zero_block()) == -1) {
+				return -1;
+			}
+			node[INODE_DINDIRECT] = ind;
+		}
+
+		if(rel % INDIRECT_ENTRIES == 0) {
+			if((ind = alloc_zero_block()) == -1) {
+				if(rel == 0) {
+					free_block(node[INODE_DINDIRECT]);
+				}
+				return -1;
+			}
+			bcache_write(fs_data_start + node[INODE_DINDIRECT], rel / INDIRECT_ENTRIES * 4, (uint8_t*)&ind, 4, BCACHE_LOAD);
+		}
+		else if(fs_read_block(node[INODE_DINDIRECT], rel / INDIRECT_ENTRIES * 4, &ind, 4) == -1) {
+			return -1;
+		}
+		rel %= INDIRECT_ENTRIES;
+	}
+
+	return bcache_write(fs_data_start + ind, rel * 4, (uint8_t*)&block, 4, BCACHE_LOAD);
+}
+
+/*	fs_unmap_last
+ *   DESCRIPTION: this function frees the last block of a file, and the indirect
+ *				  block holding its number once it holds no other
+ *   INPUTS: node -- the index node of the file
+ *			 index -- index of the last block within the file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: data blocks freed, node updated
+ */
+static void fs_unmap_last(uint32_t* node, uint32_t index) {
+	uint32_t rel;
+	uint32_t ind;
+
+	free_block(fs_bmap(node, NULL, index));
+
+	if(index < INODE_DIRECT_BLOCKS) {
+		node[index+1] = 0;
+		return;
+	}
+
+	rel = index - INODE_DIRECT_BLOCKS;
+	if(rel == 0) {
+		free_block(node[INODE_INDIRECT]);
+		node[INODE_INDIRECT] = 0;
+		return;
+	}
+
+	if(rel < INDIRECT_ENTRIES) {
+		return;
+	}
+
+	rel -= INDIRECT_ENTRIES;
+	if(rel % INDIRECT_ENTRIES == 0 && fs_read_block(node[INODE_DINDIRECT], rel / INDIRECT_ENTRIES * 4, &ind, 4) == 0) {
+		free_block(ind);
+	}
+	if(rel == 0) {
+		free_block(node[INODE_DINDIRECT]);
+		node[INODE_DINDIRECT] = 0;
+	}
+}
+
+/*	extend_inode
+ *   DESCRIPTION: this function grows a file, the new bytes read as zero
+ *   INPUTS: node -- the index node of the file
+ *			 length -- the new length, larger than the current one
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the file system is full. on failure the
+ *				   file is grown as far as the allocated blocks reach
+ *   SIDE EFFECTS: data blocks allocated, node updated
+ */
+static int32_t extend_inode(uint32_t* node, uint32_t length) {
+	uint32_t blocks;
+	uint32_t last;
+	uint32_t flags;
+	int32_t block;
+
+	// the block map and free map are shared by every process writing
+	cli_and_save(flags);
+	blocks = (node[0] + BLOCK_SIZE - 1) / BLOCK_SIZE;	// blocks in use
+	if(length <= node[0]) {
+		restore_flags(flags);
+		return 0;	// another writer got there first
+	}
+
+	// the old last block may have stale bytes past the end of file
+	if(node[0] % BLOCK_SIZE && (last = fs_bmap(node, NULL, blocks - 1)) < num_data_blocks) {
+		bcache_write(fs_data_start + last, node[0] % BLOCK_SIZE, NULL, BLOCK_SIZE - node[0] % BLOCK_SIZE, BCACHE_LOAD);
+	}
+
+	fs_map_gen++;
+	while(blocks*BLOCK_SIZE < length) {
+		if((block = alloc_zero_block()) == -1 || fs_set_bmap(node, blocks, block) == -1) {
+			if(block != -1) {
+				free_block(block);
+			}
+			node[0] = blocks*BLOCK_SIZE;
+			fs_meta_set_length(node);
+			fs_meta_dirty(node, BLOCK_SIZE);
+			restore_flags(flags);
+			return -1;	// file system is full
+		}
+		fs_meta_add_block(node, blocks, block);
+		blocks++;
+	}
+
+	node[0] = length;
+	fs_meta_set_length(node);
+	fs_meta_dirty(node, BLOCK_SIZE);
+	restore_flags(flags);
+	return 0;
+}
+
+/*	 file_write
+ *   DESCRIPTION: this function writes to the file at the file position, growing
+ *				  the file if needed. data goes to the block cache and reaches the
+ *				  file system image when the cache is flushed
+ *   INPUTS: file_desc -- file descriptor of the file
+ *			 buf   -- data to write
+ *			 nbytes -- number of bytes to write
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: number of bytes written, -1 on failure
+ *   SIDE EFFECTS: file position updated
+ */
+int32_t file_write(fd_t* file_desc,const uint8_t* buf, uint32_t nbytes) {
+
+	uint32_t* node;
+	uint32_t pos, end, chunk, block;
+	uint32_t flags;
+	uint32_t written = 0;
+
+	if( !file_desc || file_desc->flags != 1 || !file_desc->vnode || !file_desc->vnode->node || !buf) {
+		return -1;	// file not in use or file is a directory
+	}
+
+	if(!fs_writable) {
+		return -1;	// read only file system
+	}
+
+	node = file_desc->vnode->node;
+	pos = file_desc->file_pos;
+	if(pos >= FS_MAX_FILE_SIZE) {
+		return -1;	// past the largest file
+	}
+
+	end = pos + nbytes;
+	if(nbytes > FS_MAX_FILE_SIZE - pos) {
+		end = FS_MAX_FILE_SIZE;
+	}
+
+	// allocate the blocks first, write as much as fits if the file system fills up
+	cli_and_save(flags);
+	if(end > node[0] && extend_inode(node, end) == -1) {
+		if(node[0] <= pos) {
+			file_desc->vnode->length = node[0];
+			restore_flags(flags);
+			return -1;	// file system is full
+		}
+		end = node[0];
+	}
+	file_desc->vnode->length = node[0];
+	restore_flags(flags);
+
+	while(pos < end) {
+		chunk = BLOCK_SIZE - pos % BLOCK_SIZE;
+		if(chunk > end - pos) {
+			chunk = end - pos;
+		}
+
+		block = fs_bmap(node, &file_desc->vnode->xlate, pos / BLOCK_SIZE);
+		if(block >= num_data_blocks || bcache_write(fs_data_start + block, pos % BLOCK_SIZE, buf + written, chunk, BCACHE_LOAD) == -1) {
+			break;	// bad data block number
+		}
+
+		pos += chunk;
+		written += chunk;
+	}
+
+	file_desc->file_pos = pos;	//update the file position
+	return written;
+}
+
+/*	 file_truncate
+ *   DESCRIPTION: this function sets the length of a file, freeing the data
+ *				  blocks past the new end or growing it with zeros
+ *   INPUTS: file_desc -- file descriptor of the file
+ *			 length -- the new length
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 on failure or if blocks to free are still
+ *				   mapped by a program or mmap
+ *   SIDE EFFECTS: data blocks freed or allocated
+ */
+int32_t file_truncate(fd_t* file_desc, uint32_t length) {
+
+	uint32_t* node;
+	uint32_t blocks, keep;
+	uint32_t flags;
+	fs_inode_meta_t* meta;
+	int32_t ret;
+
+	if( !file_desc || file_desc->flags != 1 || !file_desc->vnode || !file_desc->vnode->node) {
+		return -1;	// file not in use or file is a directory
+	}
+
+	if(!fs_writable || length > FS_MAX_FILE_SIZE) {
+		return -1;	// read only file system or too large
+	}
+
+	node = file_desc->vnode->node;
+	cli_and_save(flags);
+	if(length > node[0]) {
+		ret = extend_inode(node, length);
+		file_desc->vnode->length = node[0];
+		restore_flags(flags);
+		return ret;
+	}
+
+	blocks = (node[0] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	keep = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+	// page tables may point at the blocks, they cannot go back to the free map
+	meta = fs_node_meta(node);
+	if(blocks > keep && meta && meta->maps) {
+		restore_flags(flags);
+		return -1;
+	}
+
+	fs_map_gen++;
+	while(blocks > keep) {
+		fs_unmap_last(node, blocks - 1);
+		blocks--;
+		node[0] = blocks*BLOCK_SIZE;
+	}
+
+	node[0] = length;
+	file_desc->vnode->length = length;
+	fs_meta_set_length(node);
+	fs_meta_dirty(node, BLOCK_SIZE);
+	restore_flags(flags);
+	return 0;
+}
+
+/*	fs_create
+ *   DESCRIPTION: this function creates an empty regular file in the root directory
+ *   INPUTS: fname -- the name of the file, at most 32 bytes and not a path
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the name is taken or invalid, or there is
+ *				   no free dentry or inode
+ *   SIDE EFFECTS: boot block, inode and filename index updated
+ */
+int32_t fs_create(const uint8_t* fname) {
+
+	dentry_t d_entry;
+	dentry_t* new_dentry;
+	uint32_t i, len;
+	uint32_t flags;
+	uint32_t* node;
+
+	if(!fs_base_adr || !fs_writable || !fname) {
+		return -1;	// not initialized or read only
+	}
+
+	for(len=0;len<=FNAME_SIZE && fname[len] != '\0';len++) {
+		if(fname[len] == '/') {
+			return -1;	// files are only created in the root directory
+		}
+	}
+	if(len == 0 || len > FNAME_SIZE) {
+		return -1;	// name is empty or too long
+	}
+
+	// the name check, the inode and the dentry slot must not race another create
+	cli_and_save(flags);
+	if(read_dentry_by_name(fname, &d_entry) == 0 || num_dentries >= MAX_DENTRIES) {
+		restore_flags(flags);
+		return -1;	// name is taken or the boot block is full
+	}
+
+	// find a free inode
+	for(i=0;i<num_index_nodes;i++) {
+		if(!(inode_bitmap[i / 8] & (1 << (i % 8)))) {
+			break;
+		}
+	}
+	if(i >= num_index_nodes) {
+		restore_flags(flags);
+		return -1;	// no free inode
+	}
+
+	inode_bitmap[i / 8] |= 1 << (i % 8);
+	node = (uint32_t*) ((uint8_t *)fs_base_adr + (i+1)*BLOCK_SIZE);
+	node[0] = 0;	// empty file
+	fs_meta_set_length(node);
+
+	//dentries start at 1st entry in boot block
+	new_dentry = (dentry_t*)(fs_base_adr)+num_dentries+1;
+	memset(new_dentry, 0, ENTRY_SIZE);
+	memcpy(new_dentry->fname, fname, len);
+	new_dentry->type = REG_FILE;
+	new_dentry->inode = i;
+
+	num_dentries++;
+	fs_base_adr[0] = num_dentries;
+	index_dentry(num_dentries - 1);
+
+	fs_meta_dirty(node, sizeof(uint32_t));
+	fs_meta_dirty(fs_base_adr, BLOCK_SIZE);	// count and new dentry
+	restore_flags(flags);
+
+	return 0;
+}
+
+/*	 file_close
+ *   DESCRIPTION: this function is called when a file is closed
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: always return 0
+ *   SIDE EFFECTS: NONE
+ */
+int32_t file_close(fd_t* file_desc) {
+
+	if(!file_desc) {
+		return -1;
+	}
+	// Set the file descriptor to NULL
+	file_desc->fops_p = NULL;
+	file_desc->file_pos = 0;	   
+	file_desc->flags = 0;	
+
+	return 0;
+}
+
+/*	 dir_open
+ *   DESCRIPTION: this function opens a directory
+ *   INPUTS: fname -- file name
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 if is directory type, -1 if type is invalid
+ *   SIDE EFFECTS: NONE
+ */
+int32_t dir_open(fd_t* file_desc,const uint8_t* fname) {
+
+	if(vfs_open(file_desc, fname) == -1) {
+		return -1;	// file not exist
+	}
+
+	// nothing is copied here, dir_read streams the names from the boot block for
+	// the root directory and from the index node of a subdirectory
+	if(file_desc->fops_p != &dir_fops) {
+		vfs_close(file_desc);
+		return -1;	// not a directory
+	}
+
+	return 0;
+}
+
+
+
+/*	dir_entry
+ *   DESCRIPTION: this function gets the dentry at the cursor of an open directory,
+ *				  from the boot block for the root directory or from the data of a
+ *				  subdirectory
+ *   INPUTS: file_desc -- file descriptor of the directory, file_pos is the cursor
+ *			 dentry -- filled in with the dentry
+ *			 len -- filled in with the length of its name
+ *   OUTPUTS: dentry, len
+ *   RETURN VALUE: 0 on success, -1 at the end of the directory
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t dir_entry(fd_t* file_desc, dentry_t* dentry, uint32_t* len) {
+
+	if(!file_desc->vnode || !file_desc->vnode->node) {
+		if(file_desc->file_pos >= num_dentries) {
+			return -1;
+		}
+		//dentries start at 1st entry in boot block, the name length was computed when the index was built
+		memcpy(dentry, (dentry_t*)(fs_base_adr)+file_desc->file_pos+1, sizeof(dentry_t));
+		*len = dentry_name_len[file_desc->file_pos];
+		return 0;
+	}
+
+	if(read_file_data(file_desc->vnode->node, NULL, file_desc->file_pos * ENTRY_SIZE, (uint8_t*)dentry, ENTRY_SIZE) != ENTRY_SIZE) {
+		return -1;
+	}
+	hash_fname(dentry->fname, len);
+	return 0;
+}
+
+/*	dir_read
+ *   DESCRIPTION: this function reads the name of the next file in the directory.
+ *				  file_pos of the descriptor is the index of the next dentry, so every
+ *				  open directory keeps its own cursor
+ *   INPUTS: file_desc -- file descriptor of the directory
+ *			 buf   -- buffer to write to
+ *			 nbytes -- size of buf
+ *   OUTPUTS: write the file name into buf, at most 32 bytes
+ *   RETURN VALUE: number of bytes written, 0 if end of directory reached
+ *   SIDE EFFECTS: buf is modified
+ */
+int32_t dir_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes) {
+
+	uint32_t len;
+	dentry_t cur_dentry;
+
+	if(!file_desc || !buf) {
+		return -1;	// null pointer
+	}
+
+	if(dir_entry(file_desc, &cur_dentry, &len) == -1) {
+		return 0;	//end of directory reached
+	}
+
+	if(len > nbytes) {
+		len = nbytes;
+	}
+	memcpy(buf, cur_dentry.fname, len);
+
+	file_desc->file_pos++;	//move to the next dentry
+	return len;
+}
+
+
+/*	dir_readdir
+ *   DESCRIPTION: this function fills an array with the next entries of the directory,
+ *				  sharing the dentry cursor with dir_read
+ *   INPUTS: file_desc -- file descriptor of the directory
+ *			 entries -- array to write to
+ *			 count -- number of entries the array can hold
+ *   OUTPUTS: name, type, inode and length of each entry
+ *   RETURN VALUE: number of entries written, 0 if end of directory reached
+ *   SIDE EFFECTS: entries is modified
+ */
+int32_t dir_readdir(fd_t* file_desc, dirent_t* entries, uint32_t count) {
+
+	uint32_t i, len;
+	dentry_t cur_dentry;
+
+	if(!file_desc || !entries) {
+		return -1;	// null pointer
+	}
+
+	for(i=0;i<count && dir_entry(file_desc, &cur_dentry, &len) == 0;i++) {
+		memcpy(entries[i].name, cur_dentry.fname, FNAME_SIZE);
+		entries[i].name_len = len;
+		entries[i].type = cur_dentry.type;
+		entries[i].inode = cur_dentry.inode;
+		entries[i].length = 0;
+		if(cur_dentry.type == REG_FILE && cur_dentry.inode < num_index_nodes) {
+			entries[i].length = get_file_length(cur_dentry.inode);
+		}
+
+		file_desc->file_pos++;	//move to the next dentry
+	}
+
+	return i;
+}
+
+
+/*	fs_stat
+ *   DESCRIPTION: this function fills in stat for an open file or directory
+ *   INPUTS: file_desc -- file descriptor of the file or directory
+ *			 stat -- struct to fill in
+ *   OUTPUTS: type, inode, length and position of the file
+ *   RETURN VALUE: 0 on success, -1 if the descriptor is not a file or directory
+ *   SIDE EFFECTS: stat is modified
+ */
+int32_t fs_stat(fd_t* file_desc, stat_t* stat) {
+
+	if(!file_desc || !stat || file_desc->flags != 1) {
+		return -1;	// null pointer or file not in use
+	}
+
+	if(file_desc->fops_p == &file_fops && file_desc->vnode && file_desc->vnode->node) {
+		stat->type = REG_FILE;
+		stat->inode = file_desc->vnode->ino;
+		stat->length = file_desc->vnode->length;
+	}
+	else if(file_desc->fops_p == &dir_fops && file_desc->vnode) {
+		stat->type = DIR_FILE;
+		stat->inode = 0;
+		stat->length = num_dentries;
+		if(file_desc->vnode->node) {
+			stat->inode = file_desc->vnode->ino;
+			stat->length = file_desc->vnode->length / ENTRY_SIZE;	// subdirectory
+		}
+	}
+	else {
+		return -1;	// not a file system object
+	}
+
+	stat->file_pos = file_desc->file_pos;
+	return 0;
 }
 
-/*	 file_write
+
+/*	dir_write
  *   DESCRIPTION: this function will always return -1 since the file system is read only
  *   INPUTS: fname -- file name
  *			 buf   -- buffer to write to
@@ -104,157 +1152,477 @@ int32_t file_read(fd_t*  file_desc, uint8_t* buf, uint32_t nbytes) {
  *   RETURN VALUE: always return -1
  *   SIDE EFFECTS: NONE
  */
-int32_t file_write(fd_t* file_desc,const uint8_t* buf, uint32_t nbytes) {
-	// read only file system
-	// always returns -1
+int32_t dir_write(fd_t* file_desc,const uint8_t* buf, uint32_t nbytes) {
+
 	return -1;	
 }
 
-/*	 file_close
- *   DESCRIPTION: this function is called when a file is closed
+
+/*	dir_close
+ *   DESCRIPTION: this function is called when directory is closed
  *   INPUTS: NONE
  *   OUTPUTS: NONE
  *   RETURN VALUE: always return 0
  *   SIDE EFFECTS: NONE
  */
-int32_t file_close(fd_t* file_desc) {
+int32_t dir_close(fd_t* file_desc) {
 
 	if(!file_desc) {
 		return -1;
 	}
-	// Set the file descriptor to NULL
+
 	file_desc->fops_p = NULL;
-	file_desc->inode_p = NULL;
 	file_desc->file_pos = 0;	   
 	file_desc->flags = 0;	
 
 	return 0;
 }
 
-/*	 dir_open
- *   DESCRIPTION: this function opens a directory and stores all file names into dir_buf
- *   INPUTS: fname -- file name
- *   OUTPUTS: dir_buf is filled with all file names, each taking 32 bytes
- *   RETURN VALUE: 0 if is directory type, -1 if type is invalid
+
+
+
+
+
+/*	hash_fname
+ *   DESCRIPTION: FNV-1a hash of a file name, at most FNAME_SIZE bytes are used
+ *				  just like the strncmp the names are compared with. a '/' ends
+ *				  the name too, so a path is hashed one component at a time
+ *   INPUTS: fname -- the file name, zero padded, null or '/' terminated
+ *   	     len -- filled with the number of bytes hashed
+ *   OUTPUTS: len
+ *   RETURN VALUE: the hash of the name
  *   SIDE EFFECTS: NONE
  */
-int32_t dir_open(fd_t* file_desc,const uint8_t* fname) {
+static uint32_t hash_fname(const uint8_t* fname, uint32_t* len) {
+	uint32_t hash = 2166136261U;	// FNV offset basis
+	uint32_t i;
 
-	dentry_t d_entry;
-	uint32_t i,j;
-
-	if( read_dentry_by_name(fname,&d_entry) == 0 ) {
-		if(d_entry.type == DIR_FILE && file_desc != NULL) {		// check file type is directory
-			
-			file_desc->fops_p = &dir_fops; // in syscall // in syscall // in syscall
-			file_desc->inode_p = NULL;
-			file_desc->file_pos = 0;	   
-			file_desc->flags = 1;
-
-			dir_length = 0;
-			// store all the file names into dir_buf
-			for(i=0;i<num_dentries;i++) {
-				if(read_dentry_by_index (i,&d_entry) == 0) {
-					// copy the file name into dir_buf
-					strncpy( (int8_t*)(dir_buf+dir_length), (int8_t*)d_entry.fname,FNAME_SIZE);	
-
-					// file names are not exactly 32 bytes, we add null characters to fill up 32 bytes
-					for(j=strlen((int8_t *)dir_buf);j<(i+1)*FNAME_SIZE;j++) {
-						dir_buf[dir_length+FNAME_SIZE+j] = '\0';
-					}
-					// length increment by file name size
-					dir_length += FNAME_SIZE;
-				}
-			}
+	for(i=0;i<FNAME_SIZE && fname[i] != '\0' && fname[i] != '/';i++) {
+		hash ^= fname[i];
+		hash *= 16777619U;		// FNV prime
+	}
+
+	*len = i;
+	return hash;
+}
+
+/*	build_dentry_index
+ *   DESCRIPTION: this function hashes every dentry name in the boot block into dentry_hash
+ *				  so read_dentry_by_name does not have to scan all dentries
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: dentry_hash, dentry_name_hash and dentry_name_len updated
+ */
+void build_dentry_index() {
+	uint32_t i;
+
+	memset(dentry_hash, DENTRY_HASH_EMPTY, DENTRY_HASH_SIZE);
+
+	for(i=0;i<num_dentries;i++) {
+		index_dentry(i);
+	}
+}
+
+/*	index_dentry
+ *   DESCRIPTION: this function adds one dentry of the boot block to the filename index
+ *   INPUTS: i -- the dentry slot
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: dentry_hash, dentry_name_hash and dentry_name_len updated
+ */
+static void index_dentry(uint32_t i) {
+	uint32_t j, len, slot;
+
+	//dentries start at 1st entry in boot block
+	dentry_t* cur_dentry = (dentry_t*)(fs_base_adr)+i+1;
+
+	dentry_name_hash[i] = hash_fname(cur_dentry->fname, &len);
+	dentry_name_len[i] = len;
 
-			return 0; // success
+	// linear probing, the table is never more than half full
+	for(j = dentry_name_hash[i] & DENTRY_HASH_MASK; dentry_hash[j] != DENTRY_HASH_EMPTY; j = (j+1) & DENTRY_HASH_MASK) {
+		slot = dentry_hash[j];
+		if(dentry_name_hash[slot] == dentry_name_hash[i] && dentry_name_len[slot] == len &&
+			strncmp((int8_t*)((dentry_t*)(fs_base_adr)+slot+1)->fname, (int8_t*)cur_dentry->fname, len) == 0) {
+			return;	// duplicate name, the first dentry wins like the old linear scan
 		}
 	}
 
-	// file not exist or not a directory
-	return -1;
+	dentry_hash[j] = i;
 }
 
+/*	fs_inode_scan
+ *   DESCRIPTION: this function checks the length and every data block number of
+ *				  an index node, the indirect blocks included, and fills in its
+ *				  metadata
+ *   INPUTS: inode -- the index node number, below FS_MAX_INODES
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: fs_inode_meta updated
+ */
+static void fs_inode_scan(uint32_t inode) {
+	fs_inode_meta_t* meta = &fs_inode_meta[inode];
+	uint32_t* node = (uint32_t*) ((uint8_t *)fs_base_adr + (inode+1)*BLOCK_SIZE);
+	uint32_t j, block;
+	xlate_t scan;
+
+	meta->length = node[0];
+	meta->num_blocks = 0;
+	meta->first_block = 0;
+	meta->flags = 0;
+
+	if(node[0] > FS_MAX_FILE_SIZE) {
+		return;		// more blocks than the block map can hold
+	}
+	meta->num_blocks = (node[0] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if(meta->num_blocks > num_data_blocks && !(fs_base_adr[FS_FLAGS_WORD] & FS_SHARED_BLOCKS)) {
+		return;		// cannot be backed by distinct data blocks
+	}
 
+	meta->flags = FS_INODE_CONTIG;
+	scan.count = 0;
+	for(j=0;j<meta->num_blocks;j++) {
+		block = fs_bmap(node, &scan, j);
+		if(block >= num_data_blocks) {
+			meta->flags = 0;
+			return;		// bad data or indirect block number
+		}
+		if(j == 0) {
+			meta->first_block = block;
+		}
+		else if(block != meta->first_block + j) {
+			meta->flags &= ~FS_INODE_CONTIG;
+		}
+	}
 
-/*	dir_read
- *   DESCRIPTION: this function reads the names of all files in the directory
- *   INPUTS: fname -- file name
- *			 buf   -- buffer to write to
- *			 length -- number of bytes to write
- *   OUTPUTS: write the file names into buf
- *   RETURN VALUE: number of bytes written, 0 if end of file reached
- *   SIDE EFFECTS: buf is modified
+	meta->flags |= FS_INODE_VALID;
+}
+
+/*	build_inode_meta
+ *   DESCRIPTION: this function validates the image once at mount: the index node
+ *				  of every dentry of the boot block, and the length and block
+ *				  numbers of every index node. the results go in fs_inode_meta so
+ *				  reads need not repeat the checks
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: fs_inode_meta updated, problems printed
  */
-int32_t dir_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes) {
+void build_inode_meta() {
+	uint32_t i, bad_inodes = 0, bad_dentries = 0;
+	dentry_t* cur_dentry;
 
-	if(!file_desc) {
-		return -1;	// inode should be null for directory
+	memset(fs_inode_meta, 0, sizeof(fs_inode_meta));
+
+	for(i=0;i<num_index_nodes && i<FS_MAX_INODES;i++) {
+		fs_inode_scan(i);
+		if(!(fs_inode_meta[i].flags & FS_INODE_VALID)) {
+			bad_inodes++;
+		}
 	}
 
-	uint32_t i;
-	uint32_t end_of_file = file_desc->file_pos >= dir_length;	//checks if end of file reached
+	for(i=0;i<num_dentries;i++) {
+		//dentries start at 1st entry in boot block
+		cur_dentry = (dentry_t*)(fs_base_adr)+i+1;
+		if(cur_dentry->type == REG_FILE && (cur_dentry->inode >= num_index_nodes ||
+			(cur_dentry->inode < FS_MAX_INODES && !(fs_inode_meta[cur_dentry->inode].flags & FS_INODE_VALID)))) {
+			bad_dentries++;
+		}
+	}
 
-	// read to the end of file or end of buffer
-	for(i=0;i<nbytes && (!end_of_file);i++) {
-		buf[i] = dir_buf[file_desc->file_pos+i];					// copy to buf
-		end_of_file = (file_desc->file_pos+i+1) >= dir_length;	// check if is end of file	
+	if(bad_inodes || bad_dentries) {
+		printf("%d invalid index nodes, %d files cannot be read\n", bad_inodes, bad_dentries);
 	}
+}
 
-	if(end_of_file) {
-		file_desc->file_pos = dir_length;
-		return 0;	//end of file reached
+/*	fs_node_meta
+ *   DESCRIPTION: this function finds the metadata of an index node
+ *   INPUTS: node -- the index node in fs_base_adr
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the metadata, NULL past FS_MAX_INODES
+ *   SIDE EFFECTS: NONE
+ */
+static fs_inode_meta_t* fs_node_meta(uint32_t* node) {
+	uint32_t inode = ((uint8_t*)node - (uint8_t*)fs_base_adr) / BLOCK_SIZE - 1;
+
+	return inode < FS_MAX_INODES ? &fs_inode_meta[inode] : NULL;
+}
+
+/*	fs_meta_add_block
+ *   DESCRIPTION: this function records a data block appended to a file in its
+ *				  metadata, a block out of sequence ends the contiguity
+ *   INPUTS: node -- the index node
+ *			 index -- index of the new block within the file
+ *			 block -- the data block number
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: fs_inode_meta updated
+ */
+static void fs_meta_add_block(uint32_t* node, uint32_t index, uint32_t block) {
+	fs_inode_meta_t* meta = fs_node_meta(node);
+
+	if(!meta) {
+		return;
 	}
 
-	file_desc->file_pos += nbytes;	//update current offset
-	return i;
+	if(index == 0) {
+		meta->first_block = block;
+	}
+	else if(block != meta->first_block + index) {
+		meta->flags &= ~FS_INODE_CONTIG;
+	}
+	meta->num_blocks = index + 1;
 }
 
+/*	fs_meta_set_length
+ *   DESCRIPTION: this function records the new length of a file in its metadata.
+ *				  an empty file is valid and contiguous again
+ *   INPUTS: node -- the index node, its length already updated
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: fs_inode_meta updated
+ */
+static void fs_meta_set_length(uint32_t* node) {
+	fs_inode_meta_t* meta = fs_node_meta(node);
 
-/*	dir_write
- *   DESCRIPTION: this function will always return -1 since the file system is read only
- *   INPUTS: fname -- file name
- *			 buf   -- buffer to write to
- *			 length -- number of bytes to write
+	if(!meta) {
+		return;
+	}
+
+	meta->length = node[0];
+	meta->num_blocks = (node[0] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if(meta->num_blocks == 0) {
+		meta->first_block = 0;
+		meta->flags = FS_INODE_VALID | FS_INODE_CONTIG;
+	}
+}
+
+/*	mark_block
+ *   DESCRIPTION: this function marks a data block used in the block bitmap
+ *   INPUTS: block -- the data block number, ignored if invalid
  *   OUTPUTS: NONE
- *   RETURN VALUE: always return -1
- *   SIDE EFFECTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: block_bitmap updated
  */
-int32_t dir_write(fd_t* file_desc,const uint8_t* buf, uint32_t nbytes) {
+static void mark_block(uint32_t block) {
+	if(block < num_data_blocks) {
+		block_bitmap[block / 8] |= 1 << (block % 8);
+	}
+}
 
-	return -1;	
+/*	mark_inode
+ *   DESCRIPTION: this function marks an inode and every data block it uses, the
+ *				  indirect blocks included, in the free maps
+ *   INPUTS: inode -- the index node number, ignored if invalid
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: inode_bitmap and block_bitmap updated
+ */
+static void mark_inode(uint32_t inode) {
+	uint32_t j, blocks, ind;
+	uint32_t* node;
+	xlate_t scan;
+
+	if(inode >= num_index_nodes) {
+		return;
+	}
+
+	inode_bitmap[inode / 8] |= 1 << (inode % 8);
+
+	node = (uint32_t*) ((uint8_t *)fs_base_adr + (inode+1)*BLOCK_SIZE);
+	blocks = (node[0] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	scan.count = 0;
+	for(j=0;j<blocks;j++) {
+		mark_block(fs_bmap(node, &scan, j));
+	}
+
+	// the indirect blocks themselves
+	if(blocks > INODE_DIRECT_BLOCKS) {
+		mark_block(node[INODE_INDIRECT]);
+	}
+	if(blocks > INODE_DIRECT_BLOCKS + INDIRECT_ENTRIES) {
+		mark_block(node[INODE_DINDIRECT]);
+		for(j=0;j*INDIRECT_ENTRIES < blocks - INODE_DIRECT_BLOCKS - INDIRECT_ENTRIES;j++) {
+			if(fs_read_block(node[INODE_DINDIRECT], j * 4, &ind, 4) == 0) {
+				mark_block(ind);
+			}
+		}
+	}
 }
 
+/*	mark_subdir
+ *   DESCRIPTION: this function marks a subdirectory and everything in it in the
+ *				  free maps
+ *   INPUTS: inode -- index node number of the subdirectory
+ *			 depth -- number of directories above it
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: inode_bitmap and block_bitmap updated
+ */
+static void mark_subdir(uint32_t inode, uint32_t depth) {
+	uint32_t offset;
+	uint32_t* node;
+	dentry_t cur_dentry;
 
-/*	dir_close
- *   DESCRIPTION: this function is called when directory is closed
+	if(inode >= num_index_nodes || depth >= FS_MAX_DEPTH || (inode_bitmap[inode / 8] & (1 << (inode % 8)))) {
+		return;		// invalid, too deep or already seen
+	}
+	mark_inode(inode);
+
+	node = (uint32_t*) ((uint8_t *)fs_base_adr + (inode+1)*BLOCK_SIZE);
+	for(offset=0;offset + ENTRY_SIZE <= node[0];offset+=ENTRY_SIZE) {
+		if(read_file_data(node, NULL, offset, (uint8_t*)&cur_dentry, ENTRY_SIZE) != ENTRY_SIZE) {
+			return;
+		}
+		if(cur_dentry.type == REG_FILE) {
+			mark_inode(cur_dentry.inode);
+		}
+		else if(is_subdir(&cur_dentry)) {
+			mark_subdir(cur_dentry.inode, depth + 1);
+		}
+	}
+}
+
+/*	build_free_maps
+ *   DESCRIPTION: this function marks every inode used by a regular file or a
+ *				  subdirectory, and every data block used by such an inode, in the
+ *				  free maps. the file system is writable only if the maps can cover
+ *				  the whole image
  *   INPUTS: NONE
  *   OUTPUTS: NONE
- *   RETURN VALUE: always return 0
- *   SIDE EFFECTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: inode_bitmap, block_bitmap and fs_writable updated
  */
-int32_t dir_close(fd_t* file_desc) {
+void build_free_maps() {
+	uint32_t i;
+	dentry_t* cur_dentry;
 
-	if(!file_desc) {
-		return -1;
+	memset(inode_bitmap, 0, sizeof(inode_bitmap));
+	memset(block_bitmap, 0, sizeof(block_bitmap));
+
+	fs_writable = num_index_nodes <= FS_MAX_INODES && num_data_blocks <= FS_MAX_DATA_BLOCKS;
+	if(!fs_writable) {
+		return;
 	}
 
-	file_desc->fops_p = NULL;
-	file_desc->inode_p = NULL;
-	file_desc->file_pos = 0;	   
-	file_desc->flags = 0;	
+	for(i=0;i<num_dentries;i++) {
+		//dentries start at 1st entry in boot block
+		cur_dentry = (dentry_t*)(fs_base_adr)+i+1;
+		if(cur_dentry->type == REG_FILE) {
+			mark_inode(cur_dentry->inode);
+		}
+		else if(is_subdir(cur_dentry)) {
+			mark_subdir(cur_dentry->inode, 0);
+		}
+	}
+}
 
-	return 0;
+/*	root_lookup
+ *   DESCRIPTION: this function looks up a name in the root directory, the dentries of
+ *				  the boot block, with one probe of the filename index
+ *   INPUTS: name -- the name, null or '/' terminated
+ *			 len -- bytes of the name hashed
+ *			 hash -- hash of the name
+ *			 dentry -- filled in if the name is found
+ *   OUTPUTS: dentry
+ *   RETURN VALUE: 0 on success, -1 with non-existent file name
+ *   SIDE EFFECTS: dentry modified
+ */
+static int32_t root_lookup (const uint8_t* name, uint32_t len, uint32_t hash, dentry_t* dentry) {
+
+	uint32_t i, slot;
+
+	// probe the index until an empty bucket is hit
+	for(i = hash & DENTRY_HASH_MASK; dentry_hash[i] != DENTRY_HASH_EMPTY; i = (i+1) & DENTRY_HASH_MASK) {
+		slot = dentry_hash[i];
+		if(dentry_name_hash[slot] != hash || dentry_name_len[slot] != len) {
+			continue;
+		}
+
+		//get the candidate directory entry, dentries start at 1st entry in boot block
+		dentry_t* cur_dentry = (dentry_t*)(fs_base_adr)+slot+1;
+
+		// file found
+		if( strncmp( (int8_t*)cur_dentry->fname,(int8_t*)name, len) == 0 ) {
+			//update the dentry with found file
+			strncpy( (int8_t*)dentry->fname, (int8_t*)cur_dentry->fname,FNAME_SIZE);
+			dentry->type = cur_dentry->type;
+			dentry->inode = cur_dentry->inode;
+
+			return 0;	// return on success
+		}
+	}
+
+	return -1; // name does not exist
+}
+
+/*	is_subdir
+ *   DESCRIPTION: this function tells a subdirectory from the "." entry of the root
+ *				  directory, which is a directory without an index node of its own
+ *   INPUTS: dentry -- the dentry
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 1 if the dentry is a subdirectory whose inode holds its dentries
+ *   SIDE EFFECTS: NONE
+ */
+static uint32_t is_subdir (const dentry_t* dentry) {
+	if(dentry->type != DIR_FILE || dentry->inode >= num_index_nodes) {
+		return 0;
+	}
+	if(dentry->fname[0] == '.' && (dentry->fname[1] == '\0' || (dentry->fname[1] == '.' && dentry->fname[2] == '\0'))) {
+		return 0;
+	}
+	return 1;
 }
 
+/*	subdir_lookup
+ *   DESCRIPTION: this function looks up a name in a subdirectory. the data of a
+ *				  subdirectory is an array of dentries, it is only scanned when the
+ *				  dentry cache does not know the answer, and the answer found or
+ *				  not is put in the cache
+ *   INPUTS: dir -- index node number of the subdirectory
+ *			 name -- the name, null or '/' terminated
+ *			 len -- bytes of the name hashed
+ *			 hash -- hash of the name
+ *			 dentry -- filled in if the name is found
+ *   OUTPUTS: dentry
+ *   RETURN VALUE: 0 on success, -1 with non-existent file name
+ *   SIDE EFFECTS: dentry modified, dentry cache updated
+ */
+static int32_t subdir_lookup (uint32_t dir, const uint8_t* name, uint32_t len, uint32_t hash, dentry_t* dentry) {
 
+	uint32_t* node = (uint32_t*) ((uint8_t *)fs_base_adr + (dir+1)*BLOCK_SIZE);
+	uint32_t offset, cur_len;
+	int32_t ret;
+	dentry_t cur_dentry;
 
+	ret = dcache_lookup(dir, name, len, hash, dentry);
+	if(ret != 1) {
+		return ret;
+	}
 
+	for(offset=0;offset + ENTRY_SIZE <= node[0];offset+=ENTRY_SIZE) {
+		if(read_file_data(node, NULL, offset, (uint8_t*)&cur_dentry, ENTRY_SIZE) != ENTRY_SIZE) {
+			return -1;	// device failed, nothing is cached
+		}
+		if(hash_fname(cur_dentry.fname, &cur_len) == hash && cur_len == len &&
+			strncmp((int8_t*)cur_dentry.fname, (int8_t*)name, len) == 0) {
+			memcpy(dentry, &cur_dentry, sizeof(dentry_t));
+			dcache_insert(dir, name, len, hash, dentry);
+			return 0;
+		}
+	}
 
+	dcache_insert(dir, name, len, hash, NULL);
+	return -1;
+}
 
 /*	read_dentry_by_name
- *   DESCRIPTION: this function will fill in dentry struct of a given file on success
- *   INPUTS: fname -- the name of file to read
+ *   DESCRIPTION: this function will fill in dentry struct of a given file on success.
+ *				  the name is a path like "/bin/shell", resolved from the root
+ *				  directory one component at a time. "." and ".." are understood,
+ *				  a path that is only "/" names the root directory
+ *   INPUTS: fname -- the name or path of the file to read
  *   	     dentry -- directory struct which contains the name, type and index for the file 
  *   OUTPUTS: dentry with filled values on success
  *   RETURN VALUE: 0 on success, -1 with non-existent file name
@@ -262,33 +1630,76 @@ int32_t dir_close(fd_t* file_desc) {
  */
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry) {
 
-	int32_t i;
+	uint32_t hash, len, next;
+	dentry_t dirs[FS_MAX_DEPTH];	// the subdirectories walked through, for ".."
+	uint32_t depth = 0;				// 0 in the root directory
+	dentry_t cur_dentry;
+
 	if(!fs_base_adr) {
 		return -1; // not initialized
 	}
 
-	if(!dentry) {
-		return -1;	// null pointer 
+	if(!dentry || !fname || fname[0] == '\0') {
+		return -1;	// null pointer or empty name
 	}
 
-	for(i=0;i<num_dentries;i++) {
-		//get current directory entry, dentries start at 1st entry in boot block
-		dentry_t* cur_dentry = (dentry_t*)(fs_base_adr)+i+1;
+	// the root directory is the "." dentry of the boot block
+	memset(&cur_dentry, 0, sizeof(dentry_t));
+	cur_dentry.fname[0] = '.';
+	cur_dentry.type = DIR_FILE;
 
-		// file found
-		if( strncmp( (int8_t*)cur_dentry->fname,(int8_t*)fname, FNAME_SIZE) == 0 ) {   // does strncmp work??
-			//update the dentry with found file
-			strncpy( (int8_t*)dentry->fname, (int8_t*)cur_dentry->fname,FNAME_SIZE);
-			dentry->type = cur_dentry->type;
-			dentry->inode = cur_dentry->inode;
+	while(*fname != '\0') {
+		if(*fname == '/') {
+			fname++;
+			continue;
+		}
 
-			return 0;	// return on success
-		}	
-		
-		
+		hash = hash_fname(fname, &len);
+		for(next=len;fname[next] != '\0' && fname[next] != '/';next++);	// names longer than FNAME_SIZE
+
+		if(cur_dentry.type != DIR_FILE) {
+			return -1;	// a file in the middle of the path
+		}
+
+		if(next == 1 && fname[0] == '.') {
+			// stay in this directory
+		}
+		else if(next == 2 && fname[0] == '.' && fname[1] == '.') {
+			if(depth) {
+				depth--;
+			}
+			if(depth) {
+				memcpy(&cur_dentry, &dirs[depth-1], sizeof(dentry_t));
+			}
+			else {
+				memset(&cur_dentry, 0, sizeof(dentry_t));
+				cur_dentry.fname[0] = '.';
+				cur_dentry.type = DIR_FILE;
+			}
+		}
+		else {
+			if(depth == 0) {
+				if(root_lookup(fname, len, hash, &cur_dentry) == -1) {
+					return -1;
+				}
+			}
+			else if(subdir_lookup(dirs[depth-1].inode, fname, len, hash, &cur_dentry) == -1) {
+				return -1;
+			}
+
+			if(is_subdir(&cur_dentry)) {
+				if(depth >= FS_MAX_DEPTH) {
+					return -1;	// nested too deep
+				}
+				memcpy(&dirs[depth++], &cur_dentry, sizeof(dentry_t));
+			}
+		}
+
+		fname += next;
 	}
 
-	return -1; // fname does not exist 
+	memcpy(dentry, &cur_dentry, sizeof(dentry_t));
+	return 0;
 }
 
 
@@ -327,13 +1738,16 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry) {
 
 
 /*	read_data
- *   DESCRIPTION: this function will read data from file system on success
+ *   DESCRIPTION: this function will read data from file system on success. the
+ *				  data blocks are walked one extent at a time and every run of
+ *				  physically contiguous blocks is moved with a single memcpy
  *   INPUTS: inode -- the index node number of a file to read
  *   	     offset -- the offset within index node to start
  * 		 	 buf --	pointer to store data into
  *			 length -- length of bytes to read
  *   OUTPUTS: data from the file
- *   RETURN VALUE: 0 on success, -1 with invalid inode or bad data block number
+ *   RETURN VALUE: number of bytes read on success, 0 at end of file,
+ *				   -1 with invalid inode or bad data block number
  *   SIDE EFFECTS: buffer modified
  */
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
@@ -350,43 +1764,110 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
 		return -1;	// null pointer 
 	}
 
-	if(offset <0 ) {
-		return -1;	//invalid offset
+	//index nodes start at 1st entry in file system
+	return read_file_data((uint32_t*) ((uint8_t *)fs_base_adr + (inode+1)*BLOCK_SIZE), NULL, offset, buf, length);
+}
+
+/*	read_file_data
+ *   DESCRIPTION: this function reads data of a file into buf, copying whole runs
+ *				  of contiguous data blocks at once
+ *   INPUTS: node -- the index node of the file
+ *			 xlate -- the translation cache of the open file, or NULL
+ *			 offset -- offset to start reading at
+ *			 buf --	pointer to store data into
+ *			 length -- length of bytes to read
+ *   OUTPUTS: data from the file
+ *   RETURN VALUE: number of bytes read on success, 0 at end of file,
+ *				   -1 with bad data block number or if the device failed
+ *   SIDE EFFECTS: buffer modified
+ */
+static int32_t read_file_data (uint32_t* node, xlate_t* xlate, uint32_t offset, uint8_t* buf, uint32_t length) {
+
+	if(!buf) {
+		return -1;	// null pointer 
 	}
-	memset(buf, 0, length);
-	uint32_t* node = (uint32_t*) ((uint8_t *)fs_base_adr + (inode+1)*BLOCK_SIZE);	//index nodes start at 1st entry in file system
+
+	fs_inode_meta_t* meta = fs_node_meta(node);
 	uint32_t file_length = node[0];		// file length
 
-	uint32_t block_index;	// index in file_block
+	uint32_t block_index = offset / BLOCK_SIZE;		// index in file_block
+	uint32_t block_offset = offset % BLOCK_SIZE;	// offset within the first data block
 	uint32_t block_number; 	// data block number in file system
-	uint8_t* cur = 0;		//pointer to current byte being read
-	uint32_t i;
+	uint8_t* src;			// start of the current contiguous extent
+	uint32_t run;			// bytes in the current contiguous extent
+	uint32_t copied = 0;
 
-	uint32_t end_of_file = offset >= file_length;	//checks if end of file reached
-	if(end_of_file) {
+	if(offset >= file_length) {
 		return 0;	//end of file reached
 	}
 
-	// read to the end of file or end of buffer
-	for(i=0;i<length && (!end_of_file);i++) {
+	// never read past the end of file
+	if(length > file_length - offset) {
+		length = file_length - offset;
+	}
+
+	if(meta) {
+		if(!(meta->flags & FS_INODE_VALID)) {
+			return -1;	// rejected at mount
+		}
+
+		// a contiguous file in memory is one copy, its blocks were checked at mount
+		if((meta->flags & FS_INODE_CONTIG) && fs_dev->base && !bcache_dirty_count) {
+			bcache_stats.direct += (offset % BLOCK_SIZE + length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+			memcpy(buf, fs_dev->base + (fs_data_start + meta->first_block)*BLOCK_SIZE + offset, length);
+			return length;
+		}
+	}
 
-		// switch to next data block if cur reaches end of data block	
-		block_index = (offset+i) / BLOCK_SIZE;  		// index of current data block in node
-		block_number = node[block_index+1];		// data block number
+	// read to the end of file or end of buffer
+	while(copied < length) {
 
-		if(block_number < 0 || block_number >= num_data_blocks) {
+		block_number = fs_bmap(node, xlate, block_index);		// data block number
+		if(block_number >= num_data_blocks) {
 			return -1;	//bad data block number
-		}	
+		}
+
+		run = BLOCK_SIZE - block_offset;
+		if(run > length - copied) {
+			run = length - copied;
+		}
+
+		// blocks of a device not resident in memory, and blocks written since
+		// the last flush, are read through the block cache
+		src = blkdev_direct(fs_dev, fs_data_start + block_number);
+		if(!src || bcache_dirty_count) {
+			if(bcache_read(fs_data_start + block_number, block_offset, buf + copied, run, src ? BCACHE_CACHED : BCACHE_LOAD) == 0) {
+				copied += run;
+				block_index++;
+				block_offset = 0;
+				continue;
+			}
+			if(!src) {
+				return -1;	// device failed
+			}
+		}
+
+		// grow the extent while the next data block sits right after this one
+		src += block_offset;
+		run = BLOCK_SIZE - block_offset;
+		while(copied + run < length && !bcache_dirty_count && fs_bmap(node, xlate, block_index+1) == block_number+1 && block_number+1 < num_data_blocks) {
+			block_index++;
+			block_number++;
+			run += BLOCK_SIZE;
+		}
+
+		if(run > length - copied) {
+			run = length - copied;
+		}
 
-		// get current pointer to the data being read
-		cur = (uint8_t*)fs_base_adr + (num_index_nodes+1+block_number)*BLOCK_SIZE + ((offset+i) % BLOCK_SIZE);
-		
-		buf[i] = *cur;	//copy data to buffer
-		cur++;	
-		end_of_file = (offset+i + 1) >= file_length;	// check if is end of file	
+		bcache_stats.direct += (block_offset + run + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		memcpy(buf + copied, src, run);
+		copied += run;
+		block_index++;
+		block_offset = 0;
 	}
 
-	return i;	//number of bytes read
+	return copied;	//number of bytes read
 }
 
 
@@ -13,8 +13,53 @@
 #define DIR_FILE 1
 #define REG_FILE 2
 #define TMN_FILE 3
-#define MAX_FILE_SIZE 62
-#define MAX_BUF_SIZE MAX_FILE_SIZE*FNAME_SIZE
+#define MOUSE_FILE 4
+
+/* whence values for lseek */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+#define MAX_DENTRIES (BLOCK_SIZE/ENTRY_SIZE - 1)	// boot block holds the stats entry plus 63 dentries
+
+/* dentry name index, must be a power of 2 and larger than MAX_DENTRIES */
+#define DENTRY_HASH_SIZE 128
+#define DENTRY_HASH_MASK (DENTRY_HASH_SIZE - 1)
+#define DENTRY_HASH_EMPTY 0xFF
+
+/* an inode is the length, the direct data block numbers, then a single and a double
+ * indirect block. indirect blocks are data blocks holding INDIRECT_ENTRIES block numbers */
+#define INODE_DIRECT_BLOCKS (BLOCK_SIZE/4 - 3)
+#define INODE_INDIRECT (BLOCK_SIZE/4 - 2)		// index in the inode of the single indirect block
+#define INODE_DINDIRECT (BLOCK_SIZE/4 - 1)		// index in the inode of the double indirect block
+#define INDIRECT_ENTRIES (BLOCK_SIZE/4)
+#define FS_MAX_FILE_SIZE 0xFFFFF000				// largest length in whole blocks that fits 32 bits
+#define FS_BAD_BLOCK 0xFFFFFFFF
+
+/* read ahead window of a sequential reader in blocks, it doubles on every
+ * sequential read up to half the block cache */
+#define RA_MIN_WINDOW 4
+#define RA_MAX_WINDOW 16
+
+/* boot block flags, in the word after the three counts. createfs leaves it 0 */
+#define FS_FLAGS_WORD 3
+#define FS_SHARED_BLOCKS 0x1		// files share identical data blocks, mounted read only
+
+/* limits of the writable file system, larger images are mounted read only */
+#define FS_MAX_DATA_BLOCKS 8192
+#define FS_MAX_INODES 1024
+
+struct blkdev;	//resolving circular include with blkdev.h
+
+/* a subdirectory is a DIR_FILE dentry with an index node whose data is an array of
+ * dentries. paths are resolved through at most this many nested subdirectories */
+#define FS_MAX_DEPTH 8
+
+/* boot block and inodes kept in memory for devices that are not memory resident */
+#define FS_META_MAX_BLOCKS 64
+
+/* index node checks made once at mount, see fs_inode_meta_t */
+#define FS_INODE_VALID 0x1		// length fits the block map and every data block number is in range
+#define FS_INODE_CONTIG 0x2		// data blocks are first_block, first_block+1, ... in file order
 
 
 /* a 64B directory entry*/
@@ -26,6 +71,37 @@ typedef struct dentry
 	uint8_t reserved[24];	// 24 bytes reserved
 } dentry_t;
 
+/* what a read needs to know about an index node, built when the file system is
+ * mounted and kept up to date by writes, so reads of a valid index node skip the
+ * per block checks and a contiguous file is copied without walking its blocks */
+typedef struct fs_inode_meta
+{
+	uint32_t length;		// file length in bytes
+	uint32_t num_blocks;	// data blocks in the file
+	uint32_t first_block;	// data block number of the first block, 0 for an empty file
+	uint32_t flags;			// FS_INODE_xxx
+	uint32_t maps;			// programs and mmaps pointing straight at its data blocks
+} fs_inode_meta_t;
+
+/* a fixed layout directory entry handed to user space by the readdir syscall */
+typedef struct dirent
+{
+	uint8_t name[FNAME_SIZE];	// file name, zero padded
+	uint32_t name_len;		// number of valid bytes in name
+	uint32_t type;			// 0 rtc file, 1 directory, 2 regular file
+	uint32_t inode;			// index node number for the file
+	uint32_t length;		// file length in bytes, 0 if not a regular file
+} dirent_t;
+
+/* file information returned by the fstat syscall */
+typedef struct stat
+{
+	uint32_t type;			// one of the xxx_FILE types
+	uint32_t inode;			// index node number, 0 if the file has none
+	uint32_t length;		// file length in bytes, number of entries for a directory
+	uint32_t file_pos;		// current read position
+} stat_t;
+
 /* a file entry in pcb, not used in cp2*/
 typedef struct file
 {
@@ -41,20 +117,38 @@ typedef struct file
 
 /*init function for file system */
 extern void fs_init (uint32_t * adr);
+/*mounts the file system stored on a block device*/
+extern int32_t fs_mount(struct blkdev* dev);
 
 /*file operetion functions */
 extern int32_t file_open (fd_t* file_desc, const uint8_t* fname) ;
 extern int32_t file_read(fd_t*  file_desc, uint8_t* buf, uint32_t nbytes);
 extern int32_t file_write(fd_t*  file_desc, const uint8_t* buf, uint32_t nbytes);
 extern int32_t file_close(fd_t*  file_desc);
+extern int32_t file_pread(fd_t* file_desc, uint8_t* buf, uint32_t nbytes, uint32_t offset);
 
 /*directory operation functions */
 extern int32_t dir_open (fd_t*  file_desc, const uint8_t* fname);
 extern int32_t dir_read (fd_t*  file_desc, uint8_t* buf, uint32_t nbytes);
 extern int32_t dir_write(fd_t*  file_desc, const uint8_t* buf, uint32_t nbytes);
 extern int32_t dir_close(fd_t*  file_desc);
+extern int32_t dir_readdir(fd_t* file_desc, dirent_t* entries, uint32_t count);
+
+/*fills in stat for an open file or directory*/
+extern int32_t fs_stat(fd_t* file_desc, stat_t* stat);
+
 
+/*helper function to build the filename index, called by fs_init*/
+void build_dentry_index();
+/*helper function to build the free inode and data block bitmaps, called by fs_init*/
+void build_free_maps();
+/*helper function to validate the index nodes and build their metadata table, called by fs_init*/
+void build_inode_meta();
 
+/*creates an empty regular file*/
+extern int32_t fs_create(const uint8_t* fname);
+/*changes the length of an open file*/
+extern int32_t file_truncate(fd_t* file_desc, uint32_t length);
 /*helper function to read dentry by name*/
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
 /*helper function to read dentry by index*/
@@ -63,6 +157,13 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
 
 uint32_t get_file_length(unsigned int inode);
+/*helper function to find a data block of a file in memory, NULL unless the device is memory resident.
+ *the address is a kernel one, page tables need it converted to physical, see block_phys in page.c*/
+uint8_t* get_block_adr(uint32_t inode, uint32_t block_index);
+/*count a mapping of the data blocks of a file, a mapped file is not shrunk*/
+int32_t fs_map_get(uint32_t inode);
+/*drop a mapping counted by fs_map_get*/
+void fs_map_put(uint32_t inode);
 
 
 #endif
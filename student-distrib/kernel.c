@@ -10,11 +10,16 @@
 #include "x86_idt.h"
 #include "rtc.h"
 #include "page.h"
+#include "frame.h"
 #include "terminal.h"
 #include "fs.h"
 #include "syscall_entry.h" 
 #include "syscalls.h"
 #include "sched.h"
+#include "ata.h"
+#include "devfs.h"
+#include "tmpfs.h"
+#include "ext2.h"
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags,bit)   ((flags) & (1 << (bit)))
@@ -30,8 +35,25 @@
 #define KB_IRQ 1
 #define MOUSE_IRQ 12
 #define RTC_IRQ 8
-// Keep track of which pcb has been used.
-int pcb_used[6];
+// ATA drive the file system can be mounted from
+blkdev_t ata_disk;
+
+/*
+ * fs_drive_option
+ *   DESCRIPTION: finds which ATA drive the command line asks to mount the file
+ *				  system from, "fs=hda" for the master and "fs=hdb" for the slave
+ *   INPUTS: cmdline - the multiboot command line
+ *   OUTPUTS: none
+ *   RETURN VALUE: ATA_MASTER or ATA_SLAVE, -1 to keep the boot module
+ *   SIDE EFFECTS: none
+ */
+int32_t fs_drive_option(const int8_t* cmdline){
+	for(; *cmdline != '\0'; cmdline++) {
+		if(strncmp(cmdline, "fs=hda", 6) == 0) return ATA_MASTER;
+		if(strncmp(cmdline, "fs=hdb", 6) == 0) return ATA_SLAVE;
+	}
+	return -1;
+}
 
 /*
  * set_trap_gate
@@ -139,7 +161,8 @@ void idt_init(){
 	set_trap_gate(11, &segment_not_present);
 	set_trap_gate(12, &stack_segment);
 	set_trap_gate(13, &general_protection);
-	set_trap_gate(14, &page_fault);
+	// an interrupt gate, a PIT tick before cr2 is read could let another fault overwrite it
+	set_intr_gate(14, &page_fault);
 	set_trap_gate(16, &coprocessor_error);
 	set_trap_gate(19, &simd_coprocessor_error);
 	set_trap_gate(17, &alignment_check);
@@ -155,6 +178,7 @@ void idt_init(){
 	set_intr_gate(40, &handle_rtc);
 
 	set_intr_gate(44, &handle_mouse);
+	set_intr_gate(46, &handle_ata);
 	
 
 }
@@ -319,6 +343,7 @@ entry (unsigned long magic, unsigned long addr)
 	/* Enable paging*/
 	printf("Enabling Paging\n");
 	paging_init();
+	frame_init(mbi);
 
 	// intialize keyboard, does nothing as of now, included for style
 	set_up_fops();
@@ -326,12 +351,31 @@ entry (unsigned long magic, unsigned long addr)
 	/* Enable read-only file system*/
 	module_t* mod = (module_t*)mbi->mods_addr;
 	fs_init ((uint32_t *)mod->mod_start);
+	devfs_init();
+	tmpfs_init();
+
+	/* a further module holding an ext2 file system is mounted read only. it
+	 * usually ends past the identity mapped 8MB, so it is read through the
+	 * kernel's mapping of physical memory, which stops at FRAME_LIMIT */
+	for (i = 1; i < mbi->mods_count; i++) {
+		if (mod[i].mod_start < FRAME_MAP_START || mod[i].mod_end > FRAME_LIMIT) {
+			printf("module %d is outside 4MB-%dMB, not mounted\n", i, FRAME_LIMIT >> 20);
+			continue;
+		}
+		if (ext2_init((uint8_t *)FRAME_VIRT(mod[i].mod_start), mod[i].mod_end - mod[i].mod_start) == 0)
+			break;
+	}
+
+	/* Mount from an ATA drive instead when the command line asks for it,
+	 * the boot module stays mounted if the drive has no file system */
+	if (CHECK_FLAG (mbi->flags, 2) && (i = fs_drive_option((int8_t *) mbi->cmdline)) != -1) {
+		if (ata_init(&ata_disk, i) == -1 || fs_mount(&ata_disk) == -1)
+			printf("no file system on ATA drive %d, using the boot module\n", i);
+	}
 
 
 	/*Initialize the PCB list*/
-	for(i = 0; i < MAX_NUM_PROG; i++){
-		pcb_used[i] = 0;
-	}
+	pcb_init();
 
 	/* Enable interrupts */
 	/* Do not enable the following until after you have set up your
@@ -346,6 +390,7 @@ entry (unsigned long magic, unsigned long addr)
 	enable_irq(RTC_IRQ);
 	enable_irq(MOUSE_IRQ);
 	enable_irq(PIT_IRQ);
+	enable_irq(ATA_IRQ);
 
 	//Clear the screen for our first program
 	clear();
@@ -14,7 +14,7 @@ static char* video_mem = (char *)VIDEO;
 static char * curr_vid_mem = (char *)VIDEO_1;
 extern pcb_t* term_curr_pcb[NUM_TERMINALS];
 
-extern int pcb_used[6];
+extern uint32_t pcb_free_count;
 
 // extern int current_active_terminal
 void
@@ -47,19 +47,13 @@ clear(void)
 void change_video_mem(int old_term_num, int new_term_num)
 {
 	// swap the video memory between 2 terminals
-	int i;
 	uint32_t flags;
 	if(old_term_num == new_term_num) return;
 	cli_and_save(flags);
 	// If max number of program is running, we shouldn't be able to
 	// switch to the terminal that is not run yet.
 	// In this case we just return
-	for(i = 0; i < MAX_NUM_PROG; i++){
-		if(pcb_used[i] == NULL) break;
-	}
-
-	// Return if we can't spawn a new terminal!!!!!!!
-	if(i == MAX_NUM_PROG && !term_curr_pcb[new_term_num]){
+	if(pcb_free_count == 0 && !term_curr_pcb[new_term_num]){
 		restore_flags(flags);
 		return;
 	}
@@ -0,0 +1,157 @@
+#include "lzdisk.h"
+
+/*	lz_length
+ *   DESCRIPTION: this function reads the extra bytes of a literal or match length,
+ *				  each 255 byte is followed by another one
+ *   INPUTS: src -- compressed data
+ *			 src_len -- bytes of compressed data
+ *			 ip -- position of the first extra byte, advanced past the last one
+ *			 len -- length so far
+ *   OUTPUTS: ip
+ *   RETURN VALUE: the length, -1 if the data ends first
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t lz_length(const uint8_t* src, uint32_t src_len, uint32_t* ip, uint32_t len) {
+	uint8_t b;
+
+	do {
+		if(*ip >= src_len || len > BLKDEV_BLOCK_SIZE) {
+			return -1;
+		}
+		b = src[(*ip)++];
+		len += b;
+	} while(b == 255);
+
+	return len;
+}
+
+/*	lz_decompress
+ *   DESCRIPTION: this function decompresses one LZ4 block. every sequence is a
+ *				  token, literals and a match of an offset and a length, the last
+ *				  sequence has literals only. every length and offset is checked
+ *				  so a corrupt image cannot write past dst
+ *   INPUTS: src -- compressed data
+ *			 src_len -- bytes of compressed data
+ *			 dst -- buffer to decompress into
+ *			 dst_len -- size of dst
+ *   OUTPUTS: dst
+ *   RETURN VALUE: number of bytes decompressed, -1 if the data is corrupt
+ *   SIDE EFFECTS: NONE
+ */
+int32_t lz_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len) {
+	uint32_t ip = 0, op = 0;
+	uint32_t token, offset;
+	int32_t len;
+
+	while(ip < src_len) {
+		token = src[ip++];
+
+		// literals
+		len = token >> 4;
+		if(len == 15 && (len = lz_length(src, src_len, &ip, len)) == -1) {
+			return -1;
+		}
+		if(len > src_len - ip || len > dst_len - op) {
+			return -1;
+		}
+		memcpy(dst + op, src + ip, len);
+		ip += len;
+		op += len;
+
+		if(ip == src_len) {
+			break;		// last sequence
+		}
+
+		// match, copied a byte at a time since it may overlap itself
+		if(src_len - ip < 2) {
+			return -1;
+		}
+		offset = src[ip] | (src[ip+1] << 8);
+		ip += 2;
+		if(!offset || offset > op) {
+			return -1;
+		}
+		len = token & 0x0F;
+		if(len == 15 && (len = lz_length(src, src_len, &ip, len)) == -1) {
+			return -1;
+		}
+		len += LZ_MIN_MATCH;
+		if(len > dst_len - op) {
+			return -1;
+		}
+		for(;len>0;len--,op++) {
+			dst[op] = dst[op - offset];
+		}
+	}
+
+	return op;
+}
+
+/*	lzdisk_start
+ *   DESCRIPTION: this function decompresses the requested block, it completes
+ *				  right away. writes are rejected by blkdev_submit
+ *   INPUTS: dev -- the device
+ *			 req -- the request
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: request completed
+ */
+static void lzdisk_start(blkdev_t* dev, blk_request_t* req) {
+	uint8_t* image = (uint8_t*) dev->priv;
+	uint32_t* offset = (uint32_t*) image + LZ_HEADER_WORDS;
+	uint32_t len = offset[req->block+1] - offset[req->block];
+
+	if(len == 0) {
+		memset(req->buf, 0, BLKDEV_BLOCK_SIZE);
+	}
+	else if(len == BLKDEV_BLOCK_SIZE) {
+		memcpy(req->buf, image + offset[req->block], BLKDEV_BLOCK_SIZE);
+	}
+	else if(lz_decompress(image + offset[req->block], len, req->buf, BLKDEV_BLOCK_SIZE) != BLKDEV_BLOCK_SIZE) {
+		blkdev_complete(dev, BLK_ERROR);
+		return;
+	}
+
+	blkdev_complete(dev, BLK_DONE);
+}
+
+/*	lzdisk_init
+ *   DESCRIPTION: this function sets up a read only device over a compressed image.
+ *				  blocks are decompressed when read, the block cache keeps the
+ *				  recently used ones
+ *   INPUTS: dev -- the device to set up
+ *			 image -- the compressed image
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the image is not compressed or its block
+ *				   index is corrupt
+ *   SIDE EFFECTS: dev is reset
+ */
+int32_t lzdisk_init(blkdev_t* dev, uint8_t* image) {
+	uint32_t* header = (uint32_t*) image;
+	uint32_t* offset = header + LZ_HEADER_WORDS;
+	uint32_t i;
+
+	if(!dev || !image || header[0] != LZ_MAGIC || !header[1]) {
+		return -1;
+	}
+
+	// blocks start after the index and follow each other
+	if(offset[0] < (LZ_HEADER_WORDS + header[1] + 1) * 4) {
+		return -1;
+	}
+	for(i=0;i<header[1];i++) {
+		if(offset[i+1] < offset[i] || offset[i+1] - offset[i] > BLKDEV_BLOCK_SIZE) {
+			return -1;
+		}
+	}
+
+	memset(dev, 0, sizeof(blkdev_t));
+	dev->num_blocks = header[1];
+	dev->base = NULL;		// every read decompresses, so it goes through the cache
+	dev->start = lzdisk_start;
+	dev->poll = NULL;
+	dev->priv = image;
+	dev->read_only = 1;
+
+	return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef _LZDISK_H
+#define _LZDISK_H
+
+#include "types.h"
+#include "lib.h"
+#include "blkdev.h"
+
+/* a compressed file system image. it starts with a header of LZ_MAGIC, the
+ * number of blocks of the uncompressed image and num_blocks+1 byte offsets of
+ * the compressed blocks from the start of the image, block i ends where block
+ * i+1 starts. a block of length 0 is all zeros, a block of BLKDEV_BLOCK_SIZE
+ * bytes is stored as is, any other block is in the LZ4 block format */
+#define LZ_MAGIC 0x53465A4C			// "LZFS"
+#define LZ_HEADER_WORDS 2			// magic and num_blocks, before the offsets
+#define LZ_MIN_MATCH 4
+
+/*set up a read only device over a compressed image in memory*/
+extern int32_t lzdisk_init(blkdev_t* dev, uint8_t* image);
+/*decompress one LZ4 block*/
+extern int32_t lz_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_len);
+
+#endif
@@ -330,3 +330,62 @@ void reset_cursor() {
 }
 
 
+
+/*
+ * mouse_file_read
+ *   DESCRIPTION: reads the cursor position and buttons of the mouse
+ *   INPUTS: file_desc - the open /dev/mouse
+ 			 buf - the buffer to write a mouse_state_t into
+ 			 nbytes - size of buf
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of bytes written, -1 if buf is too small
+ *   SIDE EFFECTS: none
+ */
+int32_t mouse_file_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes) {
+
+	mouse_state_t state;
+
+	if(buf == NULL || nbytes < sizeof(mouse_state_t)) {
+		return -1;
+	}
+
+	state.x = mouse_x[0];
+	state.y = mouse_y[0];
+	state.buttons = button[1];
+	memcpy(buf, &state, sizeof(mouse_state_t));
+	return sizeof(mouse_state_t);
+}
+
+/*
+ * mouse_file_write
+ *   DESCRIPTION: the mouse cannot be written
+ *   INPUTS: file_desc - the open /dev/mouse
+ 			 buf - ignored
+ 			 nbytes - ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: always -1
+ *   SIDE EFFECTS: none
+ */
+int32_t mouse_file_write(fd_t* file_desc, const uint8_t* buf, uint32_t nbytes) {
+	return -1;
+}
+
+/*
+ * mouse_file_close
+ *   DESCRIPTION: closes /dev/mouse
+ *   INPUTS: file_desc - the open /dev/mouse
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on invalid file descriptor
+ *   SIDE EFFECTS: none
+ */
+int32_t mouse_file_close(fd_t* file_desc) {
+
+	if(!file_desc) {
+		return -1;
+	}
+
+	file_desc->fops_p = NULL;
+	file_desc->file_pos = 0;
+	file_desc->flags = 0;
+	return 0;
+}
@@ -8,11 +8,23 @@
 uint8_t mouse_command[32];
 uint32_t selected[2];
 
+/* what a read of /dev/mouse returns */
+typedef struct mouse_state {
+	uint32_t x;			// text column of the cursor
+	uint32_t y;			// text row of the cursor
+	uint32_t buttons;	// bit 0 set while the left button is down
+} mouse_state_t;
+
 void mouse_init();
 char mouse_read();
 inline void mouse_write(char a_write) ;
 inline void mouse_wait(char a_type);
 
+// /dev/mouse file operations
+int32_t mouse_file_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes);
+int32_t mouse_file_write(fd_t* file_desc, const uint8_t* buf, uint32_t nbytes);
+int32_t mouse_file_close(fd_t* file_desc);
+
 // Helper functions
 void do_handle_mouse();
 void update_cursor();
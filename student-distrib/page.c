@@ -1,8 +1,13 @@
 #include "page.h"
+#include "lib.h"
+#include "fs.h"
+#include "bcache.h"
+#include "frame.h"
 #define VIDEO_VIRTUAL 0x8400000
 #define VIDEO 0xB8000
 #define VIDEO_BACKUP 0xBC000
-/*global page directory and kernel page_table*/
+/*kernel page directory, loaded while no program is, and the kernel page table.
+ *every program's directory starts as a copy of the kernel directory*/
 uint32_t page_directory[TABLE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 uint32_t page_table[TABLE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 uint32_t pt_vid1[TABLE_SIZE] __attribute__((aligned(PAGE_SIZE)));
@@ -10,6 +15,168 @@ uint32_t pt_vid1[TABLE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 /*table for used pages to be used by program*/
 uint32_t prog_used_page[MAX_NUM_PROG];
 
+/*page directory of each program slot, with the kernel entries copied from
+ *page_directory and the slot's own page tables. taken and kept like them*/
+uint32_t* prog_page_dir[MAX_NUM_PROG];
+
+/*4kB page tables of each program page, filled in on page faults. a table is a
+ *frame taken the first time its slot is used and kept with the slot*/
+uint32_t* prog_page_table[MAX_NUM_PROG];
+
+/*executable each program page is demand paged from*/
+prog_image_t prog_image[MAX_NUM_PROG];
+
+/*4kB page tables of each program's mmap region, kept with the slot like the
+ *program page tables, the next free page in it and the frames holding private
+ *copies of partial last pages*/
+uint32_t* mmap_page_table[MAX_NUM_PROG];
+uint32_t mmap_next_page[MAX_NUM_PROG];
+uint32_t mmap_tail_frame[MAX_NUM_PROG][MMAP_MAX_TAILS];
+uint32_t mmap_tails_used[MAX_NUM_PROG];
+/*files whose data blocks the mmap region of each program points at, counted
+ *with fs_map_get so they are not shrunk under it*/
+uint32_t mmap_inode[MAX_NUM_PROG][MMAP_MAX_FILES];
+uint32_t mmap_files_used[MAX_NUM_PROG];
+
+/*program page currently mapped at PROG_VIRT_ADR, MAX_NUM_PROG if none*/
+uint32_t cur_prog_page = MAX_NUM_PROG;
+
+/*cr3 loads, in all and in the last whole second*/
+vm_stat_t vm_stats;
+static uint32_t vm_ticks = 0;
+static uint32_t vm_reloads_mark = 0;
+
+/*
+* invlpg
+*	description: flush the TLB entry of a single page
+*	input: addr -- virtual address in the page
+*	output: none
+*	return: none
+*	side effect: TLB entry invalidated
+*/
+static inline void invlpg(uint32_t addr) {
+	asm volatile("invlpg (%0)":: "r"(addr): "memory");
+}
+
+/*
+* load_page_dir
+*	description: switch to a page directory. the TLB is flushed except for the
+*				 global kernel entries
+*	input: dir -- physical address of the page directory
+*	output: none
+*	return: none
+*	side effect: vm_stats updated
+*/
+static inline void load_page_dir(uint32_t dir) {
+	asm volatile("mov %0, %%cr3":: "r"(dir): "memory");
+	vm_stats.cr3_reloads++;
+}
+
+/*
+* pat_init
+*	description: program the PAT so WRITE_THROUGH and CACHE_DISABLE select the
+*				 memory types of page_mem_bits. without a PAT they keep their
+*				 old meaning and write combining falls back to write through
+*	input: none
+*	output: none
+*	return: none
+*	side effect: caches written back and invalidated
+*/
+static void pat_init() {
+	uint32_t eax = 1, ebx, ecx, edx;
+
+	asm volatile("cpuid": "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+	if(!(edx & CPUID_PAT)) {
+		return;
+	}
+
+	asm volatile("wrmsr":: "c"(MSR_PAT), "a"(PAT_VALUE), "d"(PAT_VALUE));
+	asm volatile("wbinvd":::"memory");
+}
+
+/*
+* page_mem_bits
+*	description: the page table bits that give a mapping a memory type, for
+*				 4kB entries and 4MB directory entries alike
+*	input: type -- MEM_WB, MEM_WC or MEM_UC
+*	output: none
+*	return: WRITE_THROUGH and CACHE_DISABLE bits to or into the entry
+*	side effect: none
+*/
+uint32_t page_mem_bits(uint32_t type) {
+	switch(type) {
+		case MEM_WC:
+			return WRITE_THROUGH;					// PA1
+		case MEM_UC:
+			return WRITE_THROUGH | CACHE_DISABLE;	// PA3
+		default:
+			return 0;								// PA0
+	}
+}
+
+/*
+* page_mem_type
+*	description: the memory type a physical address is mapped with. the VGA
+*				 window is write combining, memory up to FRAME_LIMIT is RAM and
+*				 write back, anything above is taken for memory mapped I/O
+*	input: addr -- physical address
+*	output: none
+*	return: MEM_WB, MEM_WC or MEM_UC
+*	side effect: none
+*/
+uint32_t page_mem_type(uint32_t addr) {
+	if(addr >= VGA_START && addr < VGA_END) {
+		return MEM_WC;
+	}
+	if(addr < FRAME_LIMIT) {
+		return MEM_WB;
+	}
+	return MEM_UC;
+}
+
+/*
+* alloc_table
+*	description: take a zeroed frame for a page table or directory
+*	input: none
+*	output: none
+*	return: kernel address of the table
+*			NULL if no frame is left
+*	side effect: none
+*/
+static uint32_t* alloc_table() {
+	uint32_t frame;
+
+	if(!(frame = alloc_frames(0))) {
+		return NULL;
+	}
+	memset(FRAME_VIRT(frame), 0, PAGE_SIZE);
+	return FRAME_VIRT(frame);
+}
+
+/*
+* block_phys
+*	description: find the physical address of a data block from get_block_adr,
+*				 which is a kernel address. only the identity mapped kernel page
+*				 and the kernel's mapping of physical memory can be put in a
+*				 page table, anything else has to be copied
+*	input: block -- kernel address of the block, page aligned
+*	output: none
+*	return: physical address of the block
+*			0 if it cannot be mapped
+*	side effect: none
+*/
+static uint32_t block_phys(uint8_t* block) {
+	uint32_t adr = (uint32_t) block;
+
+	if(adr >= KERNEL_ADR && adr < FRAME_BASE) {
+		return adr;	// identity mapped, where GRUB loads filesys_img
+	}
+	if(adr >= FRAME_MAP_ADR + FRAME_MAP_START && adr < FRAME_MAP_ADR + FRAME_LIMIT) {
+		return FRAME_PHYS(adr);
+	}
+	return 0;
+}
+
 
 /*
 * paging_init
@@ -31,9 +198,11 @@ void paging_init()
 	/* Set up the first 4kB to be not accessible*/
 	page_table[0] =  USER_SUPER | READ_WRITE; 
 
-	/* Set up pages for the first page table */ 
+	pat_init();
+
+	/* Set up pages for the first page table, global since every directory has them */ 
 	for(i =1; i<TABLE_SIZE;i++) {
-		page_table[i] =  address | USER_SUPER | READ_WRITE | PRESENT;   // user , read/write, present
+		page_table[i] =  address | page_mem_bits(page_mem_type(address)) | PAGE_GLOBAL | USER_SUPER | READ_WRITE | PRESENT;   // user , read/write, present
 		// skip 4 kb
 		address += PAGE_SIZE;
 	}
@@ -46,12 +215,25 @@ void paging_init()
 	page_directory[0] = (uint32_t) page_table;
 	page_directory[0] |= /*USER_SUPER | */READ_WRITE | PRESENT;	
 
-	// 4Mb page for kernel at 1
-	page_directory[1] =  KERNEL_ADR | _4MB_PAGE /*| USER_SUPER*/ | PRESENT;	// read only kernel page
+	// 4Mb page for kernel at 1, supervisor only. it has to be writable
+	// since CR0.WP makes the kernel honor read only pages
+	page_directory[1] =  KERNEL_ADR | page_mem_bits(MEM_WB) | _4MB_PAGE | PAGE_GLOBAL /*| USER_SUPER*/ | READ_WRITE | PRESENT;
+
+	// the frames programs are given and the boot modules, reachable by the
+	// kernel only. one 4MB page per directory entry
+	for(address = FRAME_MAP_START; address < FRAME_LIMIT; address += PROG_PAGE_SIZE) {
+		page_directory[(FRAME_MAP_ADR + address) >> 22] = address | page_mem_bits(MEM_WB) | _4MB_PAGE | PAGE_GLOBAL | READ_WRITE | PRESENT;
+	}
+
+	// the video page table is shared by every directory, its entry is switched
+	// by set_video_page
+	page_directory[VIDEO_VIRTUAL >> 22] = (uint32_t) pt_vid1 | USER_SUPER | READ_WRITE | PRESENT;
+
+	cur_prog_page = MAX_NUM_PROG;
 
 
 	// write pointer to page directory into PDB Register
-	asm volatile("mov %0, %%cr3":: "b"(page_directory));
+	load_page_dir((uint32_t) page_directory);
 
 	// reads cr4, setting PSE bit in cr4, and writes it back 
 	asm volatile("mov %%cr4, %0": "=b"(cr4));
@@ -59,67 +241,87 @@ void paging_init()
 	asm volatile("mov %0, %%cr4":: "b"(cr4));
 
 
-	//reads cr0, switches the "paging enable" bit, and writes it back.
+	//reads cr0, switches the "paging enable" and "write protect" bits, and writes it back.
 	asm volatile("mov %%cr0, %0": "=b"(cr0));
-	cr0 |= 0x80000000;
+	cr0 |= CR0_PG | CR0_WP;
 	asm volatile("mov %0, %%cr0":: "b"(cr0));
+
+	// kernel entries marked global survive cr3 loads
+	asm volatile("mov %%cr4, %0": "=b"(cr4));
+	cr4 |= CR4_PGE;
+	asm volatile("mov %0, %%cr4":: "b"(cr4));
 }
 
 /*
 * add_prog_page
-*	description: look for a free page to add to the program
-*	input: none
+*	description: set up the program page of a process slot and switch to its
+*				 page directory. the directory and page tables of a slot are
+*				 taken from the frame allocator the first time it is used
+*	input: idx -- the process slot
 *	output: none
-*	return: index of page on success
+*	return: idx on success
 *			-1 on failure
-*	side effect: enter protected mode, and turn on paging.
+*	side effect: program page mapped at PROG_VIRT_ADR
 */
-int32_t add_prog_page() {
-	uint32_t i;
-	uint32_t addr = 0;
-
-	for(i=0;i<MAX_NUM_PROG;i++) {
-		/* If the page is free*/
-		if(prog_used_page[i] == 0) {
-			
-			/* Set the busy bit and calculate the address*/
-			prog_used_page[i] = 1;	//set the page in use
-			addr = FIRST_PROG_ADR + i*PROG_PAGE_SIZE;	//find the physical address for the page
-
-			page_directory[PROG_PD_ENTRY] = addr | _4MB_PAGE | CACHE_DISABLE | USER_SUPER | READ_WRITE | PRESENT;	//set the pd entry for 128MB virtual address	
-			// write pointer to page directory into PDB Register
-			asm volatile("mov %0, %%cr3":: "b"(page_directory));	
-			break;
-		}
+int32_t add_prog_page(uint32_t idx) {
+
+	if(idx >= MAX_NUM_PROG || prog_used_page[idx]) {
+		return -1; // invalid idx of program
 	}
 
-	if(i >= MAX_NUM_PROG) {
-		return -1; // max number of program reached
+	// whatever was taken before running out stays with the slot
+	if(!prog_page_table[idx] && !(prog_page_table[idx] = alloc_table())) {
+		return -1; // out of memory
+	}
+	if(!mmap_page_table[idx] && !(mmap_page_table[idx] = alloc_table())) {
+		return -1;
+	}
+	if(!prog_page_dir[idx]) {
+		if(!(prog_page_dir[idx] = alloc_table())) {
+			return -1;
+		}
+		memcpy(prog_page_dir[idx], page_directory, PAGE_SIZE);
+		prog_page_dir[idx][PROG_PD_ENTRY] = FRAME_PHYS(prog_page_table[idx]) | USER_SUPER | READ_WRITE | PRESENT;	//set the pd entry for 128MB virtual address
+		prog_page_dir[idx][MMAP_PD_ENTRY] = FRAME_PHYS(mmap_page_table[idx]) | USER_SUPER | READ_WRITE | PRESENT;
 	}
 
-	return i;
+	/* Set the busy bit, nothing is mapped until the program touches it*/
+	prog_used_page[idx] = 1;	//set the page in use
+	prog_image[idx].inode = 0;
+	prog_image[idx].length = 0;
+	mmap_next_page[idx] = 0;
+	mmap_tails_used[idx] = 0;
+	mmap_files_used[idx] = 0;
+
+	cur_prog_page = idx;
+	// write pointer to page directory into PDB Register
+	load_page_dir(FRAME_PHYS(prog_page_dir[idx]));
+
+	return idx;
 }
 
 
 /*
 * set_prog_page
-*	description: set the page for program at address idx
-*	input: none
+*	description: switch to the page directory of program idx, nothing is done
+*				 if it is already the current one
+*	input: idx -- the process slot
 *	output: none
-*	return: 0
-*	side effect: enter protected mode, and turn on paging.
+*	return: 0 on success
+*			-1 on failure
+*	side effect: cr3 loaded
 */
 int32_t set_prog_page(uint32_t idx) {
 
-	if(idx < 0 || idx >= MAX_NUM_PROG) {
+	if(idx < 0 || idx >= MAX_NUM_PROG || !prog_page_dir[idx]) {
 		return -1; // invalid idx of program
 	}
 
-	uint32_t addr = FIRST_PROG_ADR + idx*PROG_PAGE_SIZE;
-
-	page_directory[PROG_PD_ENTRY] = addr | _4MB_PAGE | CACHE_DISABLE | USER_SUPER | READ_WRITE | PRESENT; //set the pd entry for 128MB virtual address	
-	// write pointer to page directory into PDB Register
-	asm volatile("mov %0, %%cr3":: "b"(page_directory));
+	if(cur_prog_page != idx) {
+		cur_prog_page = idx;
+		// write pointer to page directory into PDB Register
+		load_page_dir(FRAME_PHYS(prog_page_dir[idx]));
+	}
 
 	prog_used_page[idx] = 1;	// reset the page to be used
 
@@ -128,7 +330,7 @@ int32_t set_prog_page(uint32_t idx) {
 
 /*
 *free_prog_page
-*	description: free the page of the program
+*	description: free the page of the program and the frames it was given
 *	input: none
 *	output: none
 *	return: 0 on success
@@ -138,13 +340,42 @@ int32_t set_prog_page(uint32_t idx) {
 
 int32_t free_prog_page (uint32_t idx) {
 
+	uint32_t i;
+
 	if(idx < 0 || idx >= MAX_NUM_PROG) {
 		return -1; // invalid idx of program
 	}
 
-	page_directory[PROG_PD_ENTRY] = 0; // reset the pd_entry to 0
-	// write pointer to page directory into PDB Register
-	asm volatile("mov %0, %%cr3":: "b"(page_directory));
+	if(!prog_used_page[idx]) {
+		return -1; // nothing to free
+	}
+
+	// the kernel directory maps nothing of the program, mmapped files go away with it
+	cur_prog_page = MAX_NUM_PROG;
+	load_page_dir((uint32_t) page_directory);
+
+	// private frames go back to the frame allocator, shared ones belong to the file system
+	for(i = 0; i < TABLE_SIZE; i++) {
+		if((prog_page_table[idx][i] & PRESENT) && !(prog_page_table[idx][i] & PAGE_COW)) {
+			free_frames(prog_page_table[idx][i] & pt_mask, 0);
+		}
+		prog_page_table[idx][i] = 0;
+	}
+	memset(mmap_page_table[idx], 0, PAGE_SIZE);
+	for(i = 0; i < mmap_tails_used[idx]; i++) {
+		free_frames(mmap_tail_frame[idx][i], 0);
+	}
+	mmap_tails_used[idx] = 0;
+
+	// the file system may free the blocks once nothing points at them
+	if(prog_image[idx].length) {
+		fs_map_put(prog_image[idx].inode);
+		prog_image[idx].length = 0;
+	}
+	for(i = 0; i < mmap_files_used[idx]; i++) {
+		fs_map_put(mmap_inode[idx][i]);
+	}
+	mmap_files_used[idx] = 0;
 	
 	prog_used_page[idx] = 0;	// reset the page to be unused
 
@@ -153,50 +384,323 @@ int32_t free_prog_page (uint32_t idx) {
 
 /*
 *add_new_pt
-*	description: add a new page
-*	input: none
+*	description: map a page in the video page table, which every page
+*				 directory has at the entry of VIDEO_VIRTUAL
+*	input: vir -- virtual address, under the video page table
+*		   physical -- physical address
 *	output: none
 *	return: 0 on success
 *			-1 on failure
-*	side effect: enter protected mode, and turn on paging.
+*	side effect: TLB entry of the page invalidated
 */
 int32_t add_new_pt(uint32_t vir, uint32_t physical){
 	// Get the index for page directory and page table
 	uint32_t pd_idx = vir >> 22;
 	uint32_t pt_idx = (vir >> 12) & 0x3FF;
 
-	// Set up page directory and page table
-	page_directory[pd_idx] = (uint32_t) pt_vid1;
-	page_directory[pd_idx] |= USER_SUPER | READ_WRITE | PRESENT;
-	pt_vid1[pt_idx] = (physical & pt_mask) | 7;
-	
-	// flush TLB
-	asm volatile("mov %0, %%cr3":: "b"(page_directory));
+	if(pd_idx != (VIDEO_VIRTUAL >> 22)) {
+		return -1;
+	}
+
+	pt_vid1[pt_idx] = (physical & pt_mask) | page_mem_bits(page_mem_type(physical)) | 7;
+	invlpg(vir);
 	return 0;
 }
 
 
 int32_t set_video_page(uint32_t set_on) {
 
-	// Get the index for page directory and page table
-	uint32_t pd_idx = VIDEO_VIRTUAL >> 22;
+	// Get the index for page table
 	uint32_t pt_idx = (VIDEO_VIRTUAL >> 12) & 0x3FF;
 
-	// Set up page directory and page table
-	page_directory[pd_idx] = (uint32_t) pt_vid1;
-	page_directory[pd_idx] |= USER_SUPER | READ_WRITE | PRESENT;
-	
 	if(set_on) {
-		pt_vid1[pt_idx] = (VIDEO & pt_mask) |  USER_SUPER | READ_WRITE | PRESENT;
+		pt_vid1[pt_idx] = (VIDEO & pt_mask) | page_mem_bits(MEM_WC) | USER_SUPER | READ_WRITE | PRESENT;
 	}	
 	else {
-		pt_vid1[pt_idx] = (VIDEO_BACKUP & pt_mask) |  USER_SUPER | READ_WRITE | PRESENT;
+		pt_vid1[pt_idx] = (VIDEO_BACKUP & pt_mask) | page_mem_bits(MEM_WC) | USER_SUPER | READ_WRITE | PRESENT;
 	}
 
+	// only this page changed, the directory stays loaded
+	invlpg(VIDEO_VIRTUAL);
 
-	// write pointer to page directory into PDB Register
-	asm volatile("mov %0, %%cr3":: "b"(page_directory));
+	return 0;
+}
+
+
+/*
+* map_prog_image
+*	description: attach an executable to a program page. nothing is copied, the
+*				 page fault handler maps each page on first touch
+*	input: idx -- index of the program page
+*		   inode -- index node of the executable
+*		   length -- file length of the executable
+*	output: none
+*	return: 0 on success
+*			-1 on failure
+*	side effect: prog_image updated, the executable counted as mapped
+*/
+int32_t map_prog_image(uint32_t idx, uint32_t inode, uint32_t length) {
+
+	if(idx >= MAX_NUM_PROG) {
+		return -1; // invalid idx of program
+	}
+
+	// pages are mapped straight onto the data blocks, so they must be up to date
+	bcache_flush();
+
+	// the executable cannot shrink while the program runs
+	if(prog_image[idx].length) {
+		fs_map_put(prog_image[idx].inode);
+	}
+	if(length) {
+		fs_map_get(inode);
+	}
+
+	prog_image[idx].inode = inode;
+	prog_image[idx].length = length;
+
+	return 0;
+}
+
+/*
+* do_page_fault
+*	description: demand pages the program page. a page fully inside the executable
+*				 is mapped read only straight onto its file system data block and
+*				 copied into the program's own frame on the first write. any other
+*				 page gets the program's own frame, zero filled, holding the tail
+*				 of the executable if there is one.
+*	input: addr -- faulting address from cr2
+*		   error -- page fault error code
+*	output: none
+*	return: 0 if the fault is handled
+*			-1 if it is a real fault or no frame is left
+*	side effect: program page table updated
+*/
+int32_t do_page_fault(uint32_t addr, uint32_t error) {
+
+	uint32_t flags;
+	uint32_t page_idx, page_va, frame, src;
+	uint32_t* pte;
+	uint8_t* block;
+	prog_image_t* img;
+
+	if(addr < PROG_VIRT_ADR || addr >= PROG_VIRT_ADR + PROG_PAGE_SIZE) {
+		return -1; // not in the program page
+	}
+
+	cli_and_save(flags);
+
+	if(cur_prog_page >= MAX_NUM_PROG) {
+		restore_flags(flags);
+		return -1; // no program page mapped
+	}
+
+	page_idx = (addr - PROG_VIRT_ADR) / PAGE_SIZE;
+	page_va = PROG_VIRT_ADR + page_idx*PAGE_SIZE;
+	pte = &prog_page_table[cur_prog_page][page_idx];
+	img = &prog_image[cur_prog_page];
+
+	if(*pte & PRESENT) {
+		// only writes to copy on write pages are expected here
+		if(!(error & PF_WRITE) || !(*pte & PAGE_COW)) {
+			restore_flags(flags);
+			return -1;
+		}
+
+		if(!(frame = alloc_frames(0))) {
+			restore_flags(flags);
+			return -1; // out of memory
+		}
+		// shared pages come from block_phys, the kernel's mapping reaches all of them
+		src = *pte & pt_mask;
+		*pte = frame | page_mem_bits(MEM_WB) | USER_SUPER | READ_WRITE | PRESENT;
+		invlpg(page_va);
+		memcpy((void*) page_va, FRAME_VIRT(src), PAGE_SIZE);
+
+		restore_flags(flags);
+		return 0;
+	}
+
+	// a whole page of the executable is shared with the file system until written
+	if(!(error & PF_WRITE) && page_va >= EXEC_ADDR && page_va - EXEC_ADDR + PAGE_SIZE <= img->length) {
+		block = get_block_adr(img->inode, (page_va - EXEC_ADDR) / PAGE_SIZE);
+		if(block && (src = block_phys(block))) {
+			*pte = src | page_mem_bits(MEM_WB) | PAGE_COW | USER_SUPER | PRESENT;
+			invlpg(page_va);
+
+			restore_flags(flags);
+			return 0;
+		}
+	}
+
+	// everything else is private, zero filled with whatever part of the executable it holds
+	if(!(frame = alloc_frames(0))) {
+		restore_flags(flags);
+		return -1; // out of memory
+	}
+	*pte = frame | page_mem_bits(MEM_WB) | USER_SUPER | READ_WRITE | PRESENT;
+	invlpg(page_va);
+	memset((void*) page_va, 0, PAGE_SIZE);
+	if(page_va >= EXEC_ADDR && page_va - EXEC_ADDR < img->length) {
+		read_data(img->inode, page_va - EXEC_ADDR, (uint8_t*) page_va, PAGE_SIZE);
+	}
+
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+* map_file
+*	description: map a whole file read only into the mmap region of the current
+*				 program. full pages point straight at the file system data blocks,
+*				 a partial last page is copied into a private zero padded frame
+*	input: inode -- index node of the file
+*		   length -- file length of the file
+*		   vaddr -- filled with the address of the mapping
+*	output: vaddr
+*	return: 0 on success
+*			-1 on failure
+*	side effect: mmap page table of the program updated, the file counted as
+*				 mapped while it has full pages
+*/
+int32_t map_file(uint32_t inode, uint32_t length, uint32_t* vaddr) {
+
+	uint32_t i, first, full_pages, tail, frame;
+	uint32_t* table;
+	uint8_t* block;
+
+	if(cur_prog_page >= MAX_NUM_PROG || !vaddr) {
+		return -1; // no program page mapped
+	}
+
+	table = mmap_page_table[cur_prog_page];
+	first = mmap_next_page[cur_prog_page];
+	full_pages = length / PAGE_SIZE;
+	tail = length % PAGE_SIZE;
+
+	if(first + full_pages + (tail ? 1 : 0) > TABLE_SIZE) {
+		return -1; // mmap region is full
+	}
+
+	// pages are mapped straight onto the data blocks, so they must be up to date
+	bcache_flush();
+
+	if(tail && mmap_tails_used[cur_prog_page] >= MMAP_MAX_TAILS) {
+		return -1; // no private frame left for the tail
+	}
+
+	// count the mapping before taking block addresses, the file cannot shrink under it
+	if(full_pages) {
+		if(mmap_files_used[cur_prog_page] >= MMAP_MAX_FILES || fs_map_get(inode) == -1) {
+			return -1; // too many shared files or bad file
+		}
+	}
+
+	// full pages are shared with the file system
+	for(i=0;i<full_pages;i++) {
+		block = get_block_adr(inode, i);
+		if(!block || !(frame = block_phys(block))) {
+			// bad file or a block no page table can point at, undo what was mapped
+			memset(&table[first], 0, i*sizeof(uint32_t));
+			fs_map_put(inode);
+			return -1;
+		}
+		table[first+i] = frame | page_mem_bits(MEM_WB) | USER_SUPER | PRESENT;
+	}
+
+	if(tail) {
+		frame = alloc_frames(0);
+		if(!frame) {
+			memset(&table[first], 0, full_pages*sizeof(uint32_t));
+			if(full_pages) {
+				fs_map_put(inode);
+			}
+			return -1; // out of memory
+		}
+		memset(FRAME_VIRT(frame), 0, PAGE_SIZE);
+		if(read_data(inode, full_pages*PAGE_SIZE, FRAME_VIRT(frame), tail) != tail) {
+			free_frames(frame, 0);
+			memset(&table[first], 0, full_pages*sizeof(uint32_t));
+			if(full_pages) {
+				fs_map_put(inode);
+			}
+			return -1;
+		}
+		table[first+full_pages] = frame | page_mem_bits(MEM_WB) | USER_SUPER | PRESENT;
+		mmap_tail_frame[cur_prog_page][mmap_tails_used[cur_prog_page]++] = frame;
+	}
+
+	if(full_pages) {
+		mmap_inode[cur_prog_page][mmap_files_used[cur_prog_page]++] = inode;
+	}
+
+	mmap_next_page[cur_prog_page] = first + full_pages + (tail ? 1 : 0);
+	*vaddr = MMAP_VIRT_ADR + first*PAGE_SIZE;
 
 	return 0;
 }
 
+/*
+* alloc_kernel_page
+*	description: take a 4kB frame for the kernel, addressed through the kernel
+*				 mapping of the frames
+*	input: none
+*	output: none
+*	return: address of the page, its contents are undefined
+*			NULL if no frame is left
+*	side effect: frames_free updated
+*/
+void* alloc_kernel_page() {
+	uint32_t frame;
+
+	frame = alloc_frames(0);
+	return frame ? FRAME_VIRT(frame) : NULL;
+}
+
+/*
+* free_kernel_page
+*	description: give a page from alloc_kernel_page back to the frame allocator
+*	input: page -- address returned by alloc_kernel_page
+*	output: none
+*	return: none
+*	side effect: frames_free updated
+*/
+void free_kernel_page(void* page) {
+	if(!page) {
+		return;
+	}
+	free_frames(FRAME_PHYS(page), 0);
+}
+
+/*
+* vm_tick
+*	description: called on every PIT tick, counts the cr3 loads of each second
+*	input: none
+*	output: none
+*	return: none
+*	side effect: vm_stats updated
+*/
+void vm_tick() {
+	if(++vm_ticks >= VM_STAT_TICKS) {
+		vm_stats.cr3_reloads_per_sec = vm_stats.cr3_reloads - vm_reloads_mark;
+		vm_reloads_mark = vm_stats.cr3_reloads;
+		vm_ticks = 0;
+	}
+}
+
+/*
+* vm_get_stat
+*	description: copy the paging counters
+*	input: stat -- filled with the counters
+*	output: stat
+*	return: none
+*	side effect: none
+*/
+void vm_get_stat(vm_stat_t* stat) {
+	uint32_t flags;
+
+	cli_and_save(flags);
+	*stat = vm_stats;
+	stat->frames_free = frames_free;
+	restore_flags(flags);
+}
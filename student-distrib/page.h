@@ -8,26 +8,83 @@
 #define PAGE_SIZE 4096
 #define KERNEL_ADR 0x400000  
 #define VIDEO 0xB8000
-#define MAX_NUM_PROG 6
-#define FIRST_PROG_ADR 0x800000
+#define MAX_NUM_PROG 1024	// process slots, each one costs memory only once it is used
 #define PROG_PAGE_SIZE 0x400000
 #define PROG_PD_ENTRY 32
+#define PROG_VIRT_ADR (PROG_PD_ENTRY*PROG_PAGE_SIZE)	// 128MB, where every program is mapped
+#define MMAP_PD_ENTRY 34
+#define MMAP_VIRT_ADR (MMAP_PD_ENTRY*PROG_PAGE_SIZE)	// 136MB, where files are mmapped
+#define MMAP_MAX_TAILS 4	// private tail pages each program can have mmapped
+#define MMAP_MAX_FILES 8	// files each program can have mmapped with shared pages
 
 #define PRESENT  0x1
 #define READ_WRITE 0x2
 #define USER_SUPER 0x4
+#define WRITE_THROUGH 0x8
 #define CACHE_DISABLE 0x10
 #define _4MB_PAGE 0x80
+#define PAGE_GLOBAL 0x100	// kept in the TLB across cr3 loads, for kernel mappings
+#define PAGE_COW 0x200		// available bit, read only page that is copied on write
+
+/* page fault error code bits */
+#define PF_PRESENT 0x1
+#define PF_WRITE 0x2
+
+#define CR0_PG 0x80000000
+#define CR0_WP 0x10000		// supervisor writes honor read only pages, needed for copy on write
+#define CR4_PGE 0x80		// enables PAGE_GLOBAL
+
+/* memory types a mapping can ask page_mem_bits for */
+#define MEM_WB 0			// write back, normal RAM
+#define MEM_WC 1			// write combining, frame buffers
+#define MEM_UC 2			// uncached, memory mapped I/O
+
+/* the PAT entries WRITE_THROUGH and CACHE_DISABLE select, the PAT bit of an
+ * entry is left 0. PA0 write back, PA1 write combining, PA2 UC-, PA3 uncached,
+ * repeated in PA4-PA7 */
+#define MSR_PAT 0x277
+#define PAT_VALUE 0x00070106
+#define CPUID_PAT 0x10000	// edx bit of cpuid 1
+#define VGA_START 0xA0000	// legacy VGA window
+#define VGA_END 0xC0000
+
+#define VM_STAT_TICKS 100	// PIT ticks in a second at 100Hz
 
 #define pt_mask 0xFFFFF000
 
+/* executable backing a program page, its pages are mapped on first touch */
+typedef struct prog_image {
+	uint32_t inode;		// index node of the executable
+	uint32_t length;	// file length of the executable
+} prog_image_t;
+
+/* paging counters, returned by the vmstat system call */
+typedef struct vm_stat {
+	uint32_t cr3_reloads;			// page directory loads since boot
+	uint32_t cr3_reloads_per_sec;	// page directory loads in the last whole second
+	uint32_t frames_free;			// frames left for programs and the kernel heap
+} vm_stat_t;
+
 /* Function to initialize paging, and set
 * up some page tables.
 */
 extern void paging_init();
-extern int32_t add_prog_page();
+extern int32_t add_prog_page(uint32_t idx);
 extern int32_t free_prog_page (uint32_t idx);
 extern int32_t set_prog_page(uint32_t idx);
 extern int32_t set_video_page (uint32_t idx);
+extern int32_t map_prog_image(uint32_t idx, uint32_t inode, uint32_t length);
+extern int32_t do_page_fault(uint32_t addr, uint32_t error);
+extern int32_t map_file(uint32_t inode, uint32_t length, uint32_t* vaddr);
 int32_t add_new_pt(uint32_t vir, uint32_t physical);
+extern void* alloc_kernel_page();
+extern void free_kernel_page(void* page);
+/*page table bits giving a mapping a memory type*/
+extern uint32_t page_mem_bits(uint32_t type);
+/*memory type of a physical address*/
+extern uint32_t page_mem_type(uint32_t addr);
+/*called on every PIT tick*/
+extern void vm_tick();
+/*copy the counters*/
+extern void vm_get_stat(vm_stat_t* stat);
 #endif
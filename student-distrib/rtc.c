@@ -80,7 +80,6 @@ int rtc_open(fd_t* file_desc){
 	}
 
 	file_desc->fops_p = &rtc_fops; // in syscall
-	file_desc->inode_p = NULL;
 	file_desc->file_pos = 0;	   
 	file_desc->flags = 1;
 
@@ -212,7 +211,6 @@ int rtc_close(fd_t* file_desc){
 	}
 	// Set the file descriptor to original
 	file_desc->fops_p = NULL;
-	file_desc->inode_p = NULL;
 	file_desc->file_pos = 0;	   
 	file_desc->flags = 0;	
 
@@ -1,4 +1,6 @@
 #include "sched.h"
+#include "bcache.h"
+#include "page.h"
 #define NUM_TERMINALS 3
 #define BETA 0
 #define PIT_MODE_REG 0x43
@@ -54,6 +56,10 @@ void do_handle_pit(){
 	uint32_t is_prog = 0;
 	pcb_t * temp = get_pcb();
 
+	// periodic write back of the block cache
+	bcache_tick();
+	vm_tick();
+
 	for(j = 0; j < 3; j++){
 		if(term_curr_pcb[j] != NULL) is_prog = 1;
 		if(term_curr_pcb[j] == temp) break;
@@ -87,7 +93,9 @@ void do_handle_pit(){
 	tss.esp0 = term_curr_pcb[qindex]->tssESP;
 
 	// prepare for the swich. We have to change the paging to point to the
-	// new page table. TLB is flushed when we change the paging.
+	// new page directory. set_prog_page skips the cr3 load, and so the TLB
+	// flush, when the slot is already current. a load keeps the global
+	// kernel entries in the TLB, only the program's entries are flushed.
 
 	set_prog_page(term_curr_pcb[qindex]->pt_idx);
 
@@ -0,0 +1,207 @@
+#include "slab.h"
+
+/* the caches kmalloc serves from, by size */
+static kmem_cache_t kmalloc_caches[KMALLOC_CACHES] = {
+	KMEM_CACHE_INIT("kmalloc-16", 16, NULL),
+	KMEM_CACHE_INIT("kmalloc-32", 32, NULL),
+	KMEM_CACHE_INIT("kmalloc-64", 64, NULL),
+	KMEM_CACHE_INIT("kmalloc-128", 128, NULL),
+	KMEM_CACHE_INIT("kmalloc-256", 256, NULL),
+	KMEM_CACHE_INIT("kmalloc-512", 512, NULL),
+	KMEM_CACHE_INIT("kmalloc-1024", 1024, NULL)
+};
+
+/* the free list link of an object, past its end if the cache has a constructor */
+#define SLAB_LINK(cache, obj) ((void**) ((uint8_t*) (obj) + ((cache)->ctor ? (cache)->stride - sizeof(void*) : 0)))
+
+/*	kmem_cache_grow
+ *   DESCRIPTION: this function adds a slab to a cache, every object in it is
+ *				  constructed and put on the free list
+ *   INPUTS: cache -- the cache
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if no page is left
+ *   SIDE EFFECTS: a kernel page allocated, called with interrupts disabled
+ */
+static int32_t kmem_cache_grow(kmem_cache_t* cache) {
+	uint8_t* page;
+	uint8_t* obj;
+	slab_t* slab;
+
+	if(!cache->stride) {
+		cache->stride = SLAB_STRIDE(cache->size + (cache->ctor ? sizeof(void*) : 0));
+	}
+	if(SLAB_HEADER + cache->stride > PAGE_SIZE) {
+		return -1;	// objects do not fit in a slab
+	}
+
+	page = alloc_kernel_page();
+	if(!page) {
+		return -1;
+	}
+
+	slab = (slab_t*) page;
+	slab->cache = cache;
+	for(obj = page + SLAB_HEADER; obj + cache->stride <= page + PAGE_SIZE; obj += cache->stride) {
+		if(cache->ctor) {
+			cache->ctor(obj);
+		}
+		*SLAB_LINK(cache, obj) = cache->free;
+		cache->free = obj;
+		cache->num_free++;
+	}
+	cache->num_slabs++;
+
+	return 0;
+}
+
+/*	kmem_cache_alloc
+ *   DESCRIPTION: this function takes an object from a cache. it is in the state
+ *				  the constructor left it in, or the state it was freed in
+ *   INPUTS: cache -- the cache
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the object, NULL if no page is left
+ *   SIDE EFFECTS: the cache grows by a slab when it has no free object
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+	uint32_t flags;
+	void* obj;
+
+	cli_and_save(flags);
+	if(!cache->free && kmem_cache_grow(cache) == -1) {
+		restore_flags(flags);
+		return NULL;
+	}
+	obj = cache->free;
+	cache->free = *SLAB_LINK(cache, obj);
+	cache->num_free--;
+	restore_flags(flags);
+
+	return obj;
+}
+
+/*	kmem_cache_free
+ *   DESCRIPTION: this function gives an object back to its cache
+ *   INPUTS: cache -- the cache it was taken from
+ *			 obj -- the object, NULL does nothing
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+	uint32_t flags;
+
+	if(!obj) {
+		return;
+	}
+
+	cli_and_save(flags);
+	*SLAB_LINK(cache, obj) = cache->free;
+	cache->free = obj;
+	cache->num_free++;
+	restore_flags(flags);
+}
+
+/*	kmalloc
+ *   DESCRIPTION: this function allocates from the smallest kmalloc cache that
+ *				  fits the size
+ *   INPUTS: size -- bytes wanted, at most KMALLOC_MAX_SIZE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the memory, NULL if the size is 0 or too large or no page is left
+ *   SIDE EFFECTS: NONE
+ */
+void* kmalloc(uint32_t size) {
+	uint32_t i;
+
+	if(size == 0 || size > KMALLOC_MAX_SIZE) {
+		return NULL;
+	}
+
+	for(i = 0; (1 << (i + KMALLOC_MIN_SHIFT)) < size; i++);
+	return kmem_cache_alloc(&kmalloc_caches[i]);
+}
+
+/*	kfree
+ *   DESCRIPTION: this function frees an object, the header of its slab says
+ *				  which cache it goes back to
+ *   INPUTS: obj -- from kmalloc or kmem_cache_alloc, NULL does nothing
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+void kfree(void* obj) {
+	if(!obj) {
+		return;
+	}
+	kmem_cache_free(((slab_t*) ((uint32_t) obj & pt_mask))->cache, obj);
+}
+
+/*	arena_init
+ *   DESCRIPTION: this function sets up an empty arena
+ *   INPUTS: arena -- the arena
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+void arena_init(arena_t* arena) {
+	arena->page = NULL;
+	arena->used = 0;
+}
+
+/*	arena_alloc
+ *   DESCRIPTION: this function takes memory from the page the arena is filling,
+ *				  a new page is started when it does not fit
+ *   INPUTS: arena -- the arena
+ *			 size -- bytes wanted, at most ARENA_MAX_SIZE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the memory, NULL if the size is 0 or too large or no page is left
+ *   SIDE EFFECTS: NONE
+ */
+void* arena_alloc(arena_t* arena, uint32_t size) {
+	uint32_t flags;
+	uint8_t* page;
+	void* mem;
+
+	if(size == 0 || size > ARENA_MAX_SIZE) {
+		return NULL;
+	}
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	cli_and_save(flags);
+	if(!arena->page || arena->used + size > PAGE_SIZE) {
+		page = alloc_kernel_page();
+		if(!page) {
+			restore_flags(flags);
+			return NULL;
+		}
+		// the first word of a page links to the page before
+		*(uint8_t**) page = arena->page;
+		arena->page = page;
+		arena->used = ARENA_ALIGN;
+	}
+	mem = arena->page + arena->used;
+	arena->used += size;
+	restore_flags(flags);
+
+	return mem;
+}
+
+/*	arena_reset
+ *   DESCRIPTION: this function frees every page of an arena, leaving it empty
+ *   INPUTS: arena -- the arena
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: NONE
+ */
+void arena_reset(arena_t* arena) {
+	uint32_t flags;
+	uint8_t* page;
+
+	cli_and_save(flags);
+	while(arena->page) {
+		page = arena->page;
+		arena->page = *(uint8_t**) page;
+		free_kernel_page(page);
+	}
+	arena->used = 0;
+	restore_flags(flags);
+}
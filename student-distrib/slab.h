@@ -0,0 +1,73 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "types.h"
+#include "lib.h"
+#include "page.h"
+
+/* a slab is one kernel page, a header followed by the objects. a free object
+ * links into the free list of its cache through its first word. with a
+ * constructor the link is a word past the end of the object instead, so a
+ * freed object keeps what the constructor set up. the header is how kfree
+ * finds the cache, it costs the largest kmalloc size a quarter of its slab */
+#define SLAB_ALIGN 8		// also leaves room for the link in the smallest object
+#define SLAB_HEADER SLAB_ALIGN		// header rounded up so the objects stay aligned
+#define SLAB_STRIDE(size) (((size) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+/* sizes kmalloc serves, powers of 2 from 16 to 1024 bytes. anything larger is
+ * better off with whole pages */
+#define KMALLOC_MIN_SHIFT 4
+#define KMALLOC_MAX_SHIFT 10
+#define KMALLOC_MAX_SIZE (1 << KMALLOC_MAX_SHIFT)
+#define KMALLOC_CACHES (KMALLOC_MAX_SHIFT - KMALLOC_MIN_SHIFT + 1)
+
+/* arena allocations are rounded to this */
+#define ARENA_ALIGN 8
+#define ARENA_MAX_SIZE (PAGE_SIZE - ARENA_ALIGN)
+
+/* objects of one size. a cache only grows, its slabs are kept once taken */
+typedef struct kmem_cache
+{
+	const int8_t* name;
+	uint32_t size;				// object size
+	uint32_t stride;			// object and a link if it has a constructor, aligned. set by the first slab
+	void (*ctor)(void* obj);	// run once per object when its slab is made, may be NULL
+	void* free;					// free objects
+	uint32_t num_slabs;
+	uint32_t num_free;
+} kmem_cache_t;
+
+/* start of every slab page, finds the cache of an object from its address */
+typedef struct slab
+{
+	kmem_cache_t* cache;
+} slab_t;
+
+/* a statically set up cache, no init call needed */
+#define KMEM_CACHE_INIT(name, size, ctor) { (name), (size), 0, (ctor), NULL, 0, 0 }
+
+/* bump allocator over a chain of pages, everything is freed at once */
+typedef struct arena
+{
+	uint8_t* page;				// page allocated from, it links to the one before. NULL while empty
+	uint32_t used;				// bytes taken from it
+} arena_t;
+
+/*takes an object from a cache*/
+extern void* kmem_cache_alloc(kmem_cache_t* cache);
+/*gives an object back to its cache*/
+extern void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+/*allocates up to KMALLOC_MAX_SIZE bytes from the cache of their size*/
+extern void* kmalloc(uint32_t size);
+/*frees an object from kmalloc or any cache*/
+extern void kfree(void* obj);
+
+/*empties an arena*/
+extern void arena_init(arena_t* arena);
+/*allocates from an arena*/
+extern void* arena_alloc(arena_t* arena, uint32_t size);
+/*frees everything allocated from an arena*/
+extern void arena_reset(arena_t* arena);
+
+#endif
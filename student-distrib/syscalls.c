@@ -1,4 +1,10 @@
 #include "syscalls.h"
+#include "bcache.h"
+#include "devfs.h"
+#include "mouse.h"
+#include "tmpfs.h"
+#include "ext2.h"
+#include "frame.h"
 #define IN_USE 1
 #define VIDEO_MEMORY_ADDRESS 0x8048000
 #define VIDEO_ASSIGNED_MEM_ADDR 0x8400000
@@ -7,8 +13,16 @@
 #define MAX_FILE_NUM 8
 #define EIGHT_BIT_MASK 0xFF
 
-extern int pcb_used[MAX_NUM_PROG];
 extern pcb_t * term_curr_pcb[3];
+
+/*the PCB of each process slot, at the bottom of the slot's kernel stack. a stack
+ *is taken from the frame allocator the first time its slot is used and kept
+ *with the slot, so halt can free the slot it is still running on*/
+pcb_t* pcb_table[MAX_NUM_PROG];
+
+/*free process slots, a stack so the slot freed last is handed out first*/
+static uint16_t pcb_free[MAX_NUM_PROG];
+uint32_t pcb_free_count = 0;
 /*
  * access_ok
  *   DESCRIPTION: check if the pointer user passes in is valid
@@ -23,6 +37,20 @@ int32_t access_ok(uint32_t addr){
 	return 0;
 }
 
+/*
+ * access_ok_ro
+ *   DESCRIPTION: check if the pointer user passes in is valid for the kernel to read,
+ 				  which also allows the read only mmap region
+ *   INPUTS: addr - address of pointer
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t access_ok_ro(uint32_t addr){
+	if(addr >= MMAP_VIRT_ADR && addr < MMAP_VIRT_ADR + PAGE_SIZE_T) return 0;
+	return access_ok(addr);
+}
+
 /*
  * parse
  *   DESCRIPTION: parses the command and args for execute
@@ -79,15 +107,15 @@ int32_t parse(const uint8_t* command, uint8_t* cmd, pcb_t* new_pcb)
 
 /*
  * set_up_fops
- *   DESCRIPTION: initializes the fops table for terminal, rtc, and file system
+ *   DESCRIPTION: initializes the fops table for terminal, rtc, mouse, file system, tmpfs and ext2
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: sets function pointers
  */
 void set_up_fops(){
-	// There are just 4 different file types, so all we need to do 
-	// is set up 4 fops_table and point the whatever file
+	// There are just 8 different file types, so all we need to do 
+	// is set up 8 fops_table and point the whatever file
 	// to the correct file type
 
 	//  Terminal
@@ -113,6 +141,42 @@ void set_up_fops(){
 	dir_fops.read = (read_func) dir_read;
 	dir_fops.write = (write_func) dir_write;
 	dir_fops.close = (close_func) dir_close;
+
+	// the /dev directory
+	devfs_fops.open = NULL;
+	devfs_fops.read = (read_func) devfs_dir_read;
+	devfs_fops.write = (write_func) dir_write;
+	devfs_fops.close = (close_func) dir_close;
+
+	// Mouse
+	mouse_fops.open = NULL;
+	mouse_fops.read = (read_func) mouse_file_read;
+	mouse_fops.write = (write_func) mouse_file_write;
+	mouse_fops.close = (close_func) mouse_file_close;
+
+	// tmpfs file
+	tmpfs_fops.open = NULL;
+	tmpfs_fops.read = (read_func) tmpfs_read;
+	tmpfs_fops.write = (write_func) tmpfs_write;
+	tmpfs_fops.close = (close_func) tmpfs_close;
+
+	// the /tmp directory
+	tmpfs_dir_fops.open = NULL;
+	tmpfs_dir_fops.read = (read_func) tmpfs_dir_read;
+	tmpfs_dir_fops.write = (write_func) dir_write;
+	tmpfs_dir_fops.close = (close_func) tmpfs_close;
+
+	// ext2 file
+	ext2_fops.open = NULL;
+	ext2_fops.read = (read_func) ext2_file_read;
+	ext2_fops.write = (write_func) ext2_write;
+	ext2_fops.close = (close_func) ext2_close;
+
+	// ext2 directory
+	ext2_dir_fops.open = NULL;
+	ext2_dir_fops.read = (read_func) ext2_dir_read;
+	ext2_dir_fops.write = (write_func) ext2_write;
+	ext2_dir_fops.close = (close_func) ext2_close;
 }
 
 /*
@@ -141,28 +205,74 @@ int32_t check_magic_header(const unsigned char * buf){
 }
 
 /*
- * add_pcb
- *   DESCRIPTION: Function to allocate another process control block when executing
+ * pcb_init
+ *   DESCRIPTION: mark every process slot free
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: none
  */
-int32_t add_pcb(){
+void pcb_init(){
 	int i;
 
-	// Look for an empty PCB
+	// slot 0 ends up on top, so it is the first one used
 	for(i = 0; i < MAX_NUM_PROG; i++){
-		if(pcb_used[i] == 0) break;
+		pcb_free[i] = MAX_NUM_PROG - 1 - i;
 	}
-	
-	// Have to check if whether it's really free PCB
-	// Or all pcb are already taken up.
-	if(i < MAX_NUM_PROG) {
-		pcb_used[i] = 1;
-		return i;
+	pcb_free_count = MAX_NUM_PROG;
+}
+
+/*
+ * add_pcb
+ *   DESCRIPTION: Function to allocate another process control block when executing
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: index of the process slot, -1 if none is left
+ *   SIDE EFFECTS: the slot's kernel stack is allocated on its first use
+ */
+int32_t add_pcb(){
+	uint32_t flags;
+	uint32_t frame;
+	int32_t idx;
+
+	cli_and_save(flags);
+
+	if(pcb_free_count == 0) {
+		restore_flags(flags);
+		return -1;	// all slots are taken
+	}
+	idx = pcb_free[--pcb_free_count];
+
+	// the PCB sits at the bottom of the stack, which get_pcb relies on
+	if(!pcb_table[idx]) {
+		if(!(frame = alloc_frames(1))) {
+			pcb_free_count++;
+			restore_flags(flags);
+			return -1;	// out of memory
+		}
+		pcb_table[idx] = (pcb_t *) FRAME_VIRT(frame);
 	}
-	else return -1;
+
+	restore_flags(flags);
+	return idx;
+}
+
+/*
+ * free_pcb
+ *   DESCRIPTION: give a process slot back, its kernel stack stays with it
+ *   INPUTS: idx - index of the process slot
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void free_pcb(uint32_t idx){
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(idx < MAX_NUM_PROG && pcb_free_count < MAX_NUM_PROG) {
+		pcb_free[pcb_free_count++] = idx;
+	}
+	restore_flags(flags);
 }
 
 /*
@@ -174,10 +284,9 @@ int32_t add_pcb(){
  *   SIDE EFFECTS: none
  */
 pcb_t* get_pcb() {
-	// The way we design is this: We put each pcb at 8KB from each other
-	// and the first one is 8K away from the end of kernel space.
-	// The reason for this is so that it's easier to find the address of the current PCB
-	// And easier to implement, since we only allow up to 6 process to execute
+	// The way we design is this: every kernel stack is an 8KB block aligned
+	// to its size with the pcb at its bottom, so masking esp finds the
+	// current pcb whatever slot it belongs to
 
 	uint32_t curr_esp;
 	uint32_t flags;
@@ -206,7 +315,7 @@ int32_t initialize_pcb(pcb_t * new_pcb){
 	// init content of file desc array to 0 and NULL
 	for (i = 0; i < MAX_FILE_NUM; i++)
 	{
-		new_pcb->file_desc[i].inode_p = (uint32_t*)NULL;
+		new_pcb->file_desc[i].vnode = NULL;
 		new_pcb->file_desc[i].fops_p = (fops_table_t*)NULL;
 		new_pcb->file_desc[i].flags = (uint32_t)0;
 		new_pcb->file_desc[i].file_pos = (uint32_t)0;
@@ -219,13 +328,13 @@ int32_t initialize_pcb(pcb_t * new_pcb){
 	new_pcb->terminal_number = current_active_terminal;
 
 	/* Initialize stdin*/
-	new_pcb->file_desc[0].inode_p = NULL;
+	new_pcb->file_desc[0].vnode = NULL;
 	new_pcb->file_desc[0].fops_p = &terminal_fops;
 	new_pcb->file_desc[0].flags = 1;
 	new_pcb->file_desc[0].file_pos = 0;
 	
 	/*Initialize stdout*/
-	new_pcb->file_desc[1].inode_p = NULL;
+	new_pcb->file_desc[1].vnode = NULL;
 	new_pcb->file_desc[1].fops_p = &terminal_fops;
 	new_pcb->file_desc[1].flags = 1;
 	new_pcb->file_desc[1].file_pos = 0;
@@ -257,9 +366,17 @@ int32_t halt (uint8_t status)
 	// This may be a huge sync problem in multi-processor. But, since we're
 	// working on single processor, we don't really have this kind of problem.
 	uint32_t flags;
+	uint32_t fd;
 	pcb_t* curr_pcb_ptr;
 
 	curr_pcb_ptr = get_pcb();	// get current pcb
+
+	// close the files still open, dropping their vnodes
+	for(fd = 2; fd < MAX_FILE_NUM; fd++) {
+		if(curr_pcb_ptr->file_desc[fd].flags) {
+			vfs_close(&curr_pcb_ptr->file_desc[fd]);
+		}
+	}
 	
 	// clear the buffer, just to make sure
 	clear_buffer(curr_pcb_ptr->terminal_number);
@@ -276,7 +393,7 @@ int32_t halt (uint8_t status)
 
 		tss.esp0 = curr_pcb_ptr->old_tssESP;    
 		// free the current page
-		pcb_used[curr_pcb_ptr->pcb_idx] = 0;
+		free_pcb(curr_pcb_ptr->pcb_idx);
 
 		// set return value for current process in parent. note we take only 8 bits
 		parent_pcb_ptr->return_val = (status & EIGHT_BIT_MASK);
@@ -298,7 +415,7 @@ int32_t halt (uint8_t status)
 		// free program page and reexecute	
 		free_prog_page(curr_pcb_ptr->pt_idx);	
 		tss.esp0 = curr_pcb_ptr->old_tssESP;   
-		pcb_used[curr_pcb_ptr->pcb_idx] = 0;
+		free_pcb(curr_pcb_ptr->pcb_idx);
 		// re-execute shell, for this CP
 		execute((uint8_t*)"shell");
 	}
@@ -346,7 +463,7 @@ int32_t execute (const uint8_t* command)
 	// parse command
 	parse(command, cmd, NULL);
 	/* Check if the file exists*/
-	if(read_dentry_by_name(cmd, &dentry) == ERROR) return ERROR;
+	if(read_dentry_by_name(cmd, &dentry) == ERROR || dentry.type != REG_FILE) return ERROR;
 
 	/* Read the first 40 bytes, most important info*/
 	if(read_data(dentry.inode, 0, buf, 40) == ERROR) return ERROR;
@@ -363,12 +480,15 @@ int32_t execute (const uint8_t* command)
 	// get file length
 	length = get_file_length(dentry.inode);
 
-	//Paging
-	if((pt_idx = add_prog_page()) == ERROR) return ERROR;
-
 	// Get PCB for child process
 	if((pcb_idx = add_pcb()) == ERROR) return ERROR;
-	child_pcb = (pcb_t *) (KERNEL_STACK_BOT - ((pcb_idx + 1) * PCB_OFFSET));
+	child_pcb = pcb_table[pcb_idx];
+
+	//Paging, the program page belongs to the same slot
+	if((pt_idx = add_prog_page(pcb_idx)) == ERROR) {
+		free_pcb(pcb_idx);
+		return ERROR;
+	}
 
 	// Init pcb for child process
 	initialize_pcb(child_pcb);
@@ -405,8 +525,8 @@ int32_t execute (const uint8_t* command)
 	asm volatile("movl $ret_here, %[parent_eip]":[parent_eip]"=r"(parent_pcb->eip));	
 
 	//File loader
-	// copy the program into the address
-	read_data(dentry.inode, 0, (uint8_t *) EXEC_ADDR, length);
+	// nothing is copied, the program is paged in from the file system as it runs
+	map_prog_image(pt_idx, dentry.inode, length);
 
 	//new PCB
 	/* I think we need to update esp0 before context switch */
@@ -502,8 +622,8 @@ int32_t write (int32_t fd, const void* buf, int32_t nbytes)
 	if(fd <0  || fd >= MAX_FILE_NUM) {
 		return ERROR;	//fd is invalid
 	}
-	// check if buf is in user page.
-	if(access_ok((uint32_t) buf) == ERROR){
+	// check if buf is in user page, mmapped files can be written out too
+	if(access_ok_ro((uint32_t) buf) == ERROR){
 		return ERROR;
 	}
 
@@ -526,12 +646,6 @@ int32_t open (const uint8_t* filename)
 {
 	fd_t * file_table = get_pcb()->file_desc;
 	uint32_t fd;
-	dentry_t file_dentry;
-
-	// check if the file actually exists
-	if((!filename || read_dentry_by_name(filename, &file_dentry) != 0)) {
-		return ERROR; // invalid file name
-	}
 
 	if(access_ok((uint32_t) filename) == ERROR) return ERROR;
 
@@ -546,24 +660,10 @@ int32_t open (const uint8_t* filename)
 		return ERROR; // file_desc is full
 	}
 
-	// call type specific open function
-	switch(file_dentry.type){
-		// RTC files
-		case RTC_FILE:
-			rtc_open( (fd_t*)(&file_table[fd]) );
-			break;
-
-		// Directory
-		case DIR_FILE:
-			dir_open( (fd_t*)(&file_table[fd]), filename );
-			break;
-
-		// data files
-		case REG_FILE:
-			file_open( (fd_t*)(&file_table[fd]), filename );
-			break;
-		default:
-			return ERROR;	// file type invalid
+	// the path is looked up once here, read and write then go straight to the
+	// operations of the file
+	if(vfs_open( (fd_t*)(&file_table[fd]), filename ) == -1) {
+		return ERROR;	// file does not exist or cannot be opened
 	}
 
 	return fd;	// return the file descriptor number
@@ -589,7 +689,7 @@ int32_t close (int32_t fd)
 		return ERROR; // file already closed
 	}
 
-	return get_pcb()->file_desc[fd].fops_p->close( (fd_t*)(&get_pcb()->file_desc[fd]) );	// call appropriate close function for the given file type via table
+	return vfs_close( (fd_t*)(&get_pcb()->file_desc[fd]) );	// call appropriate close function for the given file type via table
 }
 
 /*
@@ -687,5 +787,283 @@ int32_t sigreturn (void)
 	return -1;
 }
 
+/*
+ * readdir
+ *   DESCRIPTION: the readdir syscall, reads many directory entries in one call
+ *   INPUTS: fd - the file descriptor of an open directory
+ 			 entries - the user array to fill
+ 			 count - number of entries the array can hold
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of entries read, 0 at end of directory, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t readdir (int32_t fd, dirent_t* entries, int32_t count)
+{
+	fd_t* file_desc;
+
+	if(fd <0  || fd >= MAX_FILE_NUM) {
+		return ERROR; // fd is invalid
+	}
+
+	if(count < 0 || count > PAGE_SIZE_T / sizeof(dirent_t)) {
+		return ERROR; // can never fit in the user page
+	}
+
+	// the whole array has to be in the user page
+	if(access_ok((uint32_t) entries) == ERROR ||
+		(count > 0 && access_ok((uint32_t)(entries + count) - 1) == ERROR)){
+		return ERROR;
+	}
+
+	file_desc = &get_pcb()->file_desc[fd];
+	if(file_desc->flags == 0 || file_desc->fops_p != &dir_fops) {
+		return ERROR; // not an open directory
+	}
+
+	return dir_readdir(file_desc, entries, count);
+}
+
+/*
+ * fstat
+ *   DESCRIPTION: the fstat syscall, gets the type, inode and size of an open file
+ *   INPUTS: fd - the file descriptor
+ 			 buf - the user struct to fill
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t fstat (int32_t fd, stat_t* buf)
+{
+	fd_t* file_desc;
+
+	if(fd <0  || fd >= MAX_FILE_NUM) {
+		return ERROR; // fd is invalid
+	}
+
+	if(access_ok((uint32_t) buf) == ERROR || access_ok((uint32_t)(buf + 1) - 1) == ERROR){
+		return ERROR;
+	}
+
+	file_desc = &get_pcb()->file_desc[fd];
+	if(file_desc->flags == 0) {
+		return ERROR; // file not in use
+	}
+
+	// devices have no inode or length, stdin and stdout have no vnode
+	if(file_desc->fops_p != &file_fops && file_desc->fops_p != &dir_fops) {
+		buf->type = file_desc->vnode ? file_desc->vnode->type : TMN_FILE;
+		buf->inode = 0;
+		buf->length = 0;
+		if(buf->type == REG_FILE) {	// a file of another file system, such as tmpfs
+			buf->inode = file_desc->vnode->ino;
+			buf->length = file_desc->vnode->length;
+		}
+		buf->file_pos = file_desc->file_pos;
+		return 0;
+	}
+
+	return fs_stat(file_desc, buf);
+}
+
+/*
+ * lseek
+ *   DESCRIPTION: the lseek syscall, moves the read position of a regular file
+ *   INPUTS: fd - the file descriptor
+ 			 offset - the offset relative to whence
+ 			 whence - SEEK_SET, SEEK_CUR or SEEK_END
+ *   OUTPUTS: none
+ *   RETURN VALUE: the new position on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t lseek (int32_t fd, int32_t offset, int32_t whence)
+{
+	fd_t* file_desc;
 
+	if(fd <0  || fd >= MAX_FILE_NUM) {
+		return ERROR; // fd is invalid
+	}
 
+	file_desc = &get_pcb()->file_desc[fd];
+	if(file_desc->flags == 0 || !file_desc->vnode || file_desc->vnode->type != REG_FILE) {
+		return ERROR; // not an open regular file
+	}
+
+	return vfs_lseek(file_desc, offset, whence);
+}
+
+/*
+ * pread
+ *   DESCRIPTION: the pread syscall, reads a regular file at a given offset
+ 				  without moving its read position
+ *   INPUTS: fd - the file descriptor
+ 			 buf - the buffer to read into
+ 			 nbytes - number of bytes to read
+ 			 offset - the offset in the file
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of bytes read, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset)
+{
+	fd_t* file_desc;
+
+	if(fd <0  || fd >= MAX_FILE_NUM || nbytes < 0) {
+		return ERROR; // fd is invalid
+	}
+
+	// the whole buffer, not only its start, must be in the program's memory
+	if(access_ok((uint32_t) buf) == ERROR || (nbytes > 0 && access_ok((uint32_t) buf + nbytes - 1) == ERROR)){
+		return ERROR;
+	}
+
+	file_desc = &get_pcb()->file_desc[fd];
+	if(file_desc->flags == 0 || file_desc->fops_p != &file_fops) {
+		return ERROR; // not an open regular file
+	}
+
+	return file_pread(file_desc, buf, nbytes, offset);
+}
+
+/*
+ * mmap
+ *   DESCRIPTION: the mmap syscall, maps a whole regular file read only into the
+ 				  program's address space. the mapping lasts until the program halts
+ *   INPUTS: fd - the file descriptor
+ 			 addr - filled with the start of the mapping
+ *   OUTPUTS: none
+ *   RETURN VALUE: the number of bytes mapped on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t mmap (int32_t fd, uint8_t** addr)
+{
+	fd_t* file_desc;
+	stat_t stat;
+	uint32_t vaddr;
+
+	if(fd <0  || fd >= MAX_FILE_NUM) {
+		return ERROR; // fd is invalid
+	}
+
+	// the whole pointer is stored through addr, not only its first byte
+	if(access_ok((uint32_t) addr) == ERROR || access_ok((uint32_t)(addr + 1) - 1) == ERROR) return ERROR;
+
+	file_desc = &get_pcb()->file_desc[fd];
+	if(file_desc->flags == 0 || file_desc->fops_p != &file_fops) {
+		return ERROR; // not an open regular file
+	}
+
+	if(fs_stat(file_desc, &stat) == ERROR || map_file(stat.inode, stat.length, &vaddr) == ERROR) {
+		return ERROR;
+	}
+
+	*addr = (uint8_t*) vaddr;
+	return stat.length;
+}
+
+/*
+ * create
+ *   DESCRIPTION: the create syscall, creates an empty regular file
+ *   INPUTS: filename - the path of the new file
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t create (const uint8_t* filename)
+{
+	if(access_ok((uint32_t) filename) == ERROR) return ERROR;
+
+	return vfs_create(filename);
+}
+
+/*
+ * truncate
+ *   DESCRIPTION: the truncate syscall, sets the length of an open regular file
+ *   INPUTS: fd - the file descriptor
+ 			 length - the new length
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t truncate (int32_t fd, uint32_t length)
+{
+	fd_t* file_desc;
+
+	if(fd <0  || fd >= MAX_FILE_NUM) {
+		return ERROR; // fd is invalid
+	}
+
+	file_desc = &get_pcb()->file_desc[fd];
+	if(file_desc->flags == 0 || file_desc->fops_p != &file_fops) {
+		return ERROR; // not an open regular file
+	}
+
+	return file_truncate(file_desc, length);
+}
+
+/*
+ * sync
+ *   DESCRIPTION: the sync syscall, writes every dirty cached block back now
+ 				  instead of waiting for the timer
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of blocks written back
+ *   SIDE EFFECTS: none
+ */
+int32_t sync (void)
+{
+	return bcache_flush();
+}
+
+/*
+ * cachestat
+ *   DESCRIPTION: the cachestat syscall, copies the block cache and block device
+ 				  counters, to see how much I/O a workload does
+ *   INPUTS: buf - filled with the counters
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t cachestat (bcache_stat_t* buf)
+{
+	if(access_ok((uint32_t) buf) == ERROR || access_ok((uint32_t)(buf + 1) - 1) == ERROR){
+		return ERROR;
+	}
+
+	bcache_get_stat(buf);
+	return 0;
+}
+
+/*
+ * unlink
+ *   DESCRIPTION: the unlink syscall, removes a file. a file that is still open
+ 				  keeps its data until it is closed
+ *   INPUTS: filename - the path of the file
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t unlink (const uint8_t* filename)
+{
+	if(access_ok((uint32_t) filename) == ERROR) return ERROR;
+
+	return vfs_unlink(filename);
+}
+
+/*
+ * vmstat
+ *   DESCRIPTION: the vmstat syscall, copies the paging counters, to see how
+ 				  often the page directory is switched
+ *   INPUTS: buf - filled with the counters
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t vmstat (vm_stat_t* buf)
+{
+	if(access_ok((uint32_t) buf) == ERROR || access_ok((uint32_t)(buf + 1) - 1) == ERROR){
+		return ERROR;
+	}
+
+	vm_get_stat(buf);
+	return 0;
+}
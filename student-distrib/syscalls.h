@@ -8,14 +8,17 @@
 #include "terminal.h"
 #include "x86_desc.h"
 #include "page.h"
+#include "vfs.h"
 
 #define EXEC_ADDR 0x08048000
 #define USER_STACK 0X08400000
-#define KERNEL_STACK_BOT 0x800000
-#define PCB_OFFSET 0x2000
+#define PCB_OFFSET 0x2000	// kernel stack of a process, order 1 in the frame allocator
 #define PCB_MASK  0xffffe000
-#define FIRST_PROG  (KERNEL_STACK_BOT-PCB_OFFSET)
 #define USER_PROG_ADDR 0x8000000
+
+struct dirent;	//resolving circular include with fs.h
+struct stat;
+struct bcache_stat;
 /* All calls return >= 0 on success or -1 on failure. */
 
 /*  
@@ -34,6 +37,17 @@ extern int32_t getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t vidmap (uint8_t** screen_start);
 extern int32_t set_handler (int32_t signum, void* handler);
 extern int32_t sigreturn (void);
+extern int32_t readdir (int32_t fd, struct dirent* entries, int32_t count);
+extern int32_t fstat (int32_t fd, struct stat* buf);
+extern int32_t lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+extern int32_t mmap (int32_t fd, uint8_t** addr);
+extern int32_t create (const uint8_t* filename);
+extern int32_t truncate (int32_t fd, uint32_t length);
+extern int32_t sync (void);
+extern int32_t cachestat (struct bcache_stat* buf);
+extern int32_t unlink (const uint8_t* filename);
+extern int32_t vmstat (vm_stat_t* buf);
 
 
 // fops struct
@@ -41,6 +55,12 @@ fops_table_t terminal_fops;
 fops_table_t rtc_fops;
 fops_table_t file_fops;
 fops_table_t dir_fops;
+fops_table_t devfs_fops;
+fops_table_t mouse_fops;
+fops_table_t tmpfs_fops;
+fops_table_t tmpfs_dir_fops;
+fops_table_t ext2_fops;
+fops_table_t ext2_dir_fops;
 
 enum signums {
 	DIV_ZERO = 0,
@@ -51,7 +71,14 @@ enum signums {
 	NUM_SIGNALS
 };
 
+/*process table*/
+extern pcb_t* pcb_table[MAX_NUM_PROG];
+extern uint32_t pcb_free_count;
+
 // Helper function
 pcb_t* get_pcb() ;
+void pcb_init();
+int32_t add_pcb();
+void free_pcb(uint32_t idx);
 void set_up_fops();
 #endif
@@ -0,0 +1,445 @@
+#include "tmpfs.h"
+
+static tmpfs_file_t tmpfs_files[TMPFS_MAX_FILES];
+
+static int32_t tmpfs_lookup(const uint8_t* path, uint32_t* ino, uint32_t* type);
+static int32_t tmpfs_fill(vnode_t* vnode);
+static int32_t tmpfs_create(const uint8_t* path);
+static int32_t tmpfs_unlink(const uint8_t* path);
+static void tmpfs_release(vnode_t* vnode);
+static vfs_ops_t tmpfs_ops = { tmpfs_lookup, tmpfs_fill, tmpfs_create, tmpfs_unlink, tmpfs_release };
+
+/*	tmpfs_init
+ *   DESCRIPTION: this function mounts an empty tmpfs at /tmp
+ *   INPUTS: NONE
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: vfs mount table updated
+ */
+void tmpfs_init() {
+	memset(tmpfs_files, 0, sizeof(tmpfs_files));
+	if(!vfs_mount((uint8_t*)"/tmp", &tmpfs_ops)) {
+		printf("cannot mount /tmp\n");
+	}
+}
+
+/*	tmpfs_name_len
+ *   DESCRIPTION: this function checks a file name of tmpfs, which has no
+ *				  subdirectories
+ *   INPUTS: path -- the name
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: length of the name, 0 if it is empty, too long or a path
+ *   SIDE EFFECTS: NONE
+ */
+static uint32_t tmpfs_name_len(const uint8_t* path) {
+	uint32_t len;
+
+	for(len=0;len<=FNAME_SIZE && path[len] != '\0';len++) {
+		if(path[len] == '/') {
+			return 0;
+		}
+	}
+
+	return len > FNAME_SIZE ? 0 : len;
+}
+
+/*	tmpfs_find
+ *   DESCRIPTION: this function finds a named file
+ *   INPUTS: path -- the name
+ *			 len -- length of the name
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: index of the file, -1 if there is none
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t tmpfs_find(const uint8_t* path, uint32_t len) {
+	uint32_t i;
+
+	for(i=0;i<TMPFS_MAX_FILES;i++) {
+		if(tmpfs_files[i].name_len == len && strncmp((int8_t*)tmpfs_files[i].name, (int8_t*)path, len) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*	tmpfs_free_pages
+ *   DESCRIPTION: this function gives every page of a file back to the kernel
+ *   INPUTS: file -- the file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: the file is empty
+ */
+static void tmpfs_free_pages(tmpfs_file_t* file) {
+	uint32_t i;
+
+	for(i=0;i<file->num_pages;i++) {
+		free_kernel_page(file->index[i]);
+	}
+	free_kernel_page(file->index);
+
+	file->index = NULL;
+	file->num_pages = 0;
+	file->length = 0;
+}
+
+/*	tmpfs_lookup
+ *   DESCRIPTION: this function finds a file by name, the empty path is the /tmp
+ *				  directory itself
+ *   INPUTS: path -- the path below /tmp
+ *			 ino -- filled in with the index of the file
+ *			 type -- filled in with the type of the file
+ *   OUTPUTS: ino, type
+ *   RETURN VALUE: 0 on success, -1 if there is no such file
+ *   SIDE EFFECTS: NONE
+ */
+static int32_t tmpfs_lookup(const uint8_t* path, uint32_t* ino, uint32_t* type) {
+	int32_t i;
+	uint32_t len;
+
+	if(path[0] == '\0') {
+		*ino = VFS_ROOT_INO;
+		*type = DIR_FILE;
+		return 0;
+	}
+
+	len = tmpfs_name_len(path);
+	if(len == 0 || (i = tmpfs_find(path, len)) == -1) {
+		return -1;
+	}
+
+	*ino = i;
+	*type = REG_FILE;
+	return 0;
+}
+
+/*	tmpfs_fill
+ *   DESCRIPTION: this function sets up the vnode of /tmp or of a file in it
+ *   INPUTS: vnode -- the vnode, ino and type filled in by tmpfs_lookup
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if there is no such file
+ *   SIDE EFFECTS: vnode modified
+ */
+static int32_t tmpfs_fill(vnode_t* vnode) {
+
+	if(vnode->ino == VFS_ROOT_INO) {
+		vnode->fops = &tmpfs_dir_fops;
+		return 0;
+	}
+
+	if(vnode->ino >= TMPFS_MAX_FILES || !tmpfs_files[vnode->ino].in_use) {
+		return -1;
+	}
+
+	tmpfs_files[vnode->ino].open = 1;
+	vnode->fops = &tmpfs_fops;
+	vnode->length = tmpfs_files[vnode->ino].length;
+	return 0;
+}
+
+/*	tmpfs_release
+ *   DESCRIPTION: this function is called when the last descriptor of a file is
+ *				  closed, a file unlinked while open is freed now
+ *   INPUTS: vnode -- the vnode
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: pages of an unlinked file freed
+ */
+static void tmpfs_release(vnode_t* vnode) {
+	tmpfs_file_t* file;
+
+	if(vnode->ino >= TMPFS_MAX_FILES) {
+		return;		// the directory
+	}
+
+	file = &tmpfs_files[vnode->ino];
+	file->open = 0;
+	if(!file->name_len) {
+		tmpfs_free_pages(file);
+		file->in_use = 0;
+	}
+}
+
+/*	tmpfs_create
+ *   DESCRIPTION: this function creates an empty file, no memory is taken until
+ *				  it is written
+ *   INPUTS: path -- the name of the file, at most 32 bytes and not a path
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the name is taken or invalid, or there is
+ *				   no free slot
+ *   SIDE EFFECTS: file table updated
+ */
+static int32_t tmpfs_create(const uint8_t* path) {
+	uint32_t i, len;
+	uint32_t flags;
+
+	len = tmpfs_name_len(path);
+	if(len == 0) {
+		return -1;	// name is empty, too long or a path
+	}
+
+	cli_and_save(flags);
+	if(tmpfs_find(path, len) != -1) {
+		restore_flags(flags);
+		return -1;	// name is taken
+	}
+
+	for(i=0;i<TMPFS_MAX_FILES;i++) {
+		if(!tmpfs_files[i].in_use) {
+			break;
+		}
+	}
+	if(i >= TMPFS_MAX_FILES) {
+		restore_flags(flags);
+		return -1;	// no free slot
+	}
+
+	memset(&tmpfs_files[i], 0, sizeof(tmpfs_file_t));
+	memcpy(tmpfs_files[i].name, path, len);
+	tmpfs_files[i].name_len = len;
+	tmpfs_files[i].in_use = 1;
+	restore_flags(flags);
+
+	return 0;
+}
+
+/*	tmpfs_unlink
+ *   DESCRIPTION: this function removes a file. its pages go back to the kernel
+ *				  now, or when it is last closed if it is still open
+ *   INPUTS: path -- the name of the file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if there is no such file
+ *   SIDE EFFECTS: file table updated, pages freed
+ */
+static int32_t tmpfs_unlink(const uint8_t* path) {
+	int32_t i;
+	uint32_t len;
+	uint32_t flags;
+
+	len = tmpfs_name_len(path);
+	if(len == 0) {
+		return -1;
+	}
+
+	cli_and_save(flags);
+	if((i = tmpfs_find(path, len)) == -1) {
+		restore_flags(flags);
+		return -1;	// no such file
+	}
+
+	tmpfs_files[i].name_len = 0;
+	if(!tmpfs_files[i].open) {
+		tmpfs_free_pages(&tmpfs_files[i]);
+		tmpfs_files[i].in_use = 0;
+	}
+	restore_flags(flags);
+
+	return 0;
+}
+
+/*	tmpfs_page
+ *   DESCRIPTION: this function finds the page holding a block of a file, adding
+ *				  zeroed pages up to it when asked to
+ *   INPUTS: file -- the file
+ *			 index -- index of the page within the file
+ *			 grow -- allocate the page if the file is shorter
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: address of the page, NULL if it is past the end of file and
+ *				   grow is 0, or the kernel is out of pages
+ *   SIDE EFFECTS: pages allocated
+ */
+static uint8_t* tmpfs_page(tmpfs_file_t* file, uint32_t index, uint32_t grow) {
+	uint32_t flags;
+	uint8_t* page;
+
+	if(index < file->num_pages) {
+		return file->index[index];
+	}
+
+	if(!grow || index >= TMPFS_INDEX_ENTRIES) {
+		return NULL;
+	}
+
+	// another process writing the same file may be growing it too
+	cli_and_save(flags);
+	if(!file->index && !(file->index = alloc_kernel_page())) {
+		restore_flags(flags);
+		return NULL;
+	}
+
+	while(file->num_pages <= index) {
+		if(!(page = alloc_kernel_page())) {
+			restore_flags(flags);
+			return NULL;
+		}
+		memset(page, 0, PAGE_SIZE);
+		file->index[file->num_pages++] = page;
+	}
+	restore_flags(flags);
+
+	return file->index[index];
+}
+
+/*	tmpfs_read
+ *   DESCRIPTION: this function reads a file from its file position
+ *   INPUTS: file_desc -- file descriptor of the file
+ *			 buf   -- buffer to write to
+ *			 nbytes -- number of bytes to read
+ *   OUTPUTS: write the file data into buf
+ *   RETURN VALUE: number of bytes read, 0 if end of file reached, -1 on failure
+ *   SIDE EFFECTS: file position updated
+ */
+int32_t tmpfs_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes) {
+	tmpfs_file_t* file;
+	uint32_t pos, chunk;
+	uint32_t copied = 0;
+	uint8_t* page;
+
+	if(!file_desc || file_desc->flags != 1 || !file_desc->vnode || !buf) {
+		return -1;
+	}
+
+	file = &tmpfs_files[file_desc->vnode->ino];
+	pos = file_desc->file_pos;
+	if(pos >= file->length) {
+		return 0;	//end of file reached
+	}
+	if(nbytes > file->length - pos) {
+		nbytes = file->length - pos;
+	}
+
+	while(copied < nbytes) {
+		chunk = PAGE_SIZE - pos % PAGE_SIZE;
+		if(chunk > nbytes - copied) {
+			chunk = nbytes - copied;
+		}
+
+		// a hole left by a write past the end of file reads as zeros
+		page = tmpfs_page(file, pos / PAGE_SIZE, 0);
+		if(page) {
+			memcpy(buf + copied, page + pos % PAGE_SIZE, chunk);
+		}
+		else {
+			memset(buf + copied, 0, chunk);
+		}
+
+		pos += chunk;
+		copied += chunk;
+	}
+
+	file_desc->file_pos = pos;
+	return copied;
+}
+
+/*	tmpfs_write
+ *   DESCRIPTION: this function writes a file at its file position, growing it a
+ *				  page at a time. an append touches only the last page
+ *   INPUTS: file_desc -- file descriptor of the file
+ *			 buf   -- data to write
+ *			 nbytes -- number of bytes to write
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: number of bytes written, -1 if nothing could be written
+ *   SIDE EFFECTS: file position and length updated, pages allocated
+ */
+int32_t tmpfs_write(fd_t* file_desc, const uint8_t* buf, uint32_t nbytes) {
+	tmpfs_file_t* file;
+	uint32_t pos, chunk;
+	uint32_t flags;
+	uint32_t written = 0;
+	uint8_t* page;
+
+	if(!file_desc || file_desc->flags != 1 || !file_desc->vnode || !buf) {
+		return -1;
+	}
+
+	file = &tmpfs_files[file_desc->vnode->ino];
+	pos = file_desc->file_pos;
+	if(pos >= TMPFS_MAX_FILE_SIZE) {
+		return -1;	// past the largest file
+	}
+	if(nbytes > TMPFS_MAX_FILE_SIZE - pos) {
+		nbytes = TMPFS_MAX_FILE_SIZE - pos;
+	}
+
+	while(written < nbytes) {
+		chunk = PAGE_SIZE - pos % PAGE_SIZE;
+		if(chunk > nbytes - written) {
+			chunk = nbytes - written;
+		}
+
+		page = tmpfs_page(file, pos / PAGE_SIZE, 1);
+		if(!page) {
+			break;	// out of memory
+		}
+		memcpy(page + pos % PAGE_SIZE, buf + written, chunk);
+
+		pos += chunk;
+		written += chunk;
+	}
+
+	cli_and_save(flags);
+	if(pos > file->length) {
+		file->length = pos;
+		file_desc->vnode->length = pos;
+	}
+	restore_flags(flags);
+	file_desc->file_pos = pos;
+
+	return (written || !nbytes) ? (int32_t)written : -1;
+}
+
+/*	tmpfs_close
+ *   DESCRIPTION: this function is called when a file or /tmp is closed
+ *   INPUTS: file_desc -- the file descriptor
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 on invalid file descriptor
+ *   SIDE EFFECTS: NONE
+ */
+int32_t tmpfs_close(fd_t* file_desc) {
+
+	if(!file_desc) {
+		return -1;
+	}
+
+	file_desc->fops_p = NULL;
+	file_desc->file_pos = 0;
+	file_desc->flags = 0;
+	return 0;
+}
+
+/*	tmpfs_dir_read
+ *   DESCRIPTION: this function reads the name of the next file of /tmp, file_pos
+ *				  of the descriptor is the slot to continue from
+ *   INPUTS: file_desc -- file descriptor of /tmp
+ *			 buf   -- buffer to write to
+ *			 nbytes -- size of buf
+ *   OUTPUTS: write the file name into buf
+ *   RETURN VALUE: number of bytes written, 0 if end of directory reached
+ *   SIDE EFFECTS: buf is modified
+ */
+int32_t tmpfs_dir_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes) {
+	uint32_t i, len;
+
+	if(!file_desc || !buf) {
+		return -1;	// null pointer
+	}
+
+	for(i=file_desc->file_pos;i<TMPFS_MAX_FILES;i++) {
+		if(tmpfs_files[i].name_len) {
+			break;
+		}
+	}
+	if(i >= TMPFS_MAX_FILES) {
+		file_desc->file_pos = TMPFS_MAX_FILES;
+		return 0;	//end of directory reached
+	}
+
+	len = tmpfs_files[i].name_len;
+	if(len > nbytes) {
+		len = nbytes;
+	}
+	memcpy(buf, tmpfs_files[i].name, len);
+
+	file_desc->file_pos = i + 1;
+	return len;
+}
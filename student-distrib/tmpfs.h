@@ -0,0 +1,38 @@
+#ifndef _TMPFS_H
+#define _TMPFS_H
+
+#include "types.h"
+#include "lib.h"
+#include "fs.h"
+#include "vfs.h"
+#include "page.h"
+
+#define TMPFS_MAX_FILES 32
+#define TMPFS_INDEX_ENTRIES (PAGE_SIZE/4)	// data pages listed in the index page of a file
+#define TMPFS_MAX_FILE_SIZE (TMPFS_INDEX_ENTRIES*PAGE_SIZE)
+
+/* a file kept in memory. its data is in whole pages from alloc_kernel_page,
+ * the index page holds their addresses in file order so a read or an append
+ * finds its page without walking anything */
+typedef struct tmpfs_file
+{
+	uint8_t name[FNAME_SIZE];
+	uint32_t name_len;		// 0 if the file has no name
+	uint32_t in_use;		// the slot holds a file, named or still open after unlink
+	uint32_t open;			// a vnode of the file exists
+	uint32_t length;		// file length in bytes
+	uint32_t num_pages;		// data pages allocated, the first entries of index
+	uint8_t** index;		// page holding the data page addresses, NULL while empty
+} tmpfs_file_t;
+
+/*mounts an empty tmpfs at /tmp*/
+extern void tmpfs_init();
+
+/*file operations of tmpfs files*/
+extern int32_t tmpfs_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes);
+extern int32_t tmpfs_write(fd_t* file_desc, const uint8_t* buf, uint32_t nbytes);
+extern int32_t tmpfs_close(fd_t* file_desc);
+/*reads the name of the next file of /tmp*/
+extern int32_t tmpfs_dir_read(fd_t* file_desc, uint8_t* buf, uint32_t nbytes);
+
+#endif
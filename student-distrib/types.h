@@ -24,16 +24,23 @@ typedef unsigned char uint8_t;
 
 
 struct fops_table;	//resolving circular typedef
+struct vnode;
 
 /* File Descriptor */
 
 typedef struct file_desc {
 
 	struct fops_table * fops_p; // pointer to file operations table for the process
-	uint32_t* inode_p;	   // node index pointer
+	struct vnode* vnode;   // the open file, NULL for stdin and stdout
 	uint32_t file_pos;	   // current read position
 	uint32_t flags;		   // 1 = in use, 0 = not in use
 
+	/* read ahead state, a read starting at ra_pos continues a sequential stream
+	 * and grows ra_window, file blocks before ra_end were already requested */
+	uint32_t ra_pos;
+	uint32_t ra_window;
+	uint32_t ra_end;
+
 } fd_t;
 
 /* File Operations Table */
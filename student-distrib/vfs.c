@@ -0,0 +1,360 @@
+#include "vfs.h"
+#include "fs.h"
+
+static vfs_mount_t vfs_mounts[VFS_MAX_MOUNTS];
+static kmem_cache_t vnode_cache = KMEM_CACHE_INIT("vnode", sizeof(vnode_t), NULL);
+static vnode_t* vnode_list = NULL;		// every vnode with a reference
+
+/*	vfs_mount
+ *   DESCRIPTION: this function mounts a file system at a path. a file system
+ *				  mounted again at the same path replaces the old one, vnodes
+ *				  still open on the old one are detached and never found again
+ *   INPUTS: path -- the mount point, "" or "/" for the root
+ *			 ops -- lookup and fill of the file system
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the mount, NULL if the path is too long or the table is full
+ *   SIDE EFFECTS: mount table updated
+ */
+vfs_mount_t* vfs_mount(const uint8_t* path, vfs_ops_t* ops) {
+	uint32_t i, len;
+	vfs_mount_t* mnt = NULL;
+	vnode_t* vnode;
+
+	if(!path || !ops) {
+		return NULL;
+	}
+
+	while(*path == '/') {
+		path++;
+	}
+	len = strlen((int8_t*)path);
+	if(len >= VFS_PATH_SIZE) {
+		return NULL;	// mount point too long
+	}
+
+	for(i=0;i<VFS_MAX_MOUNTS;i++) {
+		if(vfs_mounts[i].ops && vfs_mounts[i].path_len == len &&
+			strncmp((int8_t*)vfs_mounts[i].path, (int8_t*)path, len) == 0) {
+			mnt = &vfs_mounts[i];	// mounted again
+			break;
+		}
+		if(!vfs_mounts[i].ops && !mnt) {
+			mnt = &vfs_mounts[i];
+		}
+	}
+	if(!mnt) {
+		return NULL;	// mount table full
+	}
+
+	for(vnode = vnode_list; vnode; vnode = vnode->next) {
+		if(vnode->mnt == mnt) {
+			vnode->mnt = NULL;
+		}
+	}
+
+	memcpy(mnt->path, path, len + 1);
+	mnt->path_len = len;
+	mnt->ops = ops;
+	return mnt;
+}
+
+/*	vfs_find_mount
+ *   DESCRIPTION: this function finds the mount a path is under, the one with the
+ *				  longest mount point that is a whole prefix of the path
+ *   INPUTS: path -- the path
+ *			 rest -- filled in with the path below the mount point
+ *   OUTPUTS: rest
+ *   RETURN VALUE: the mount, NULL if nothing is mounted there
+ *   SIDE EFFECTS: NONE
+ */
+static vfs_mount_t* vfs_find_mount(const uint8_t* path, const uint8_t** rest) {
+	uint32_t i, len;
+	const uint8_t* p = path;
+	vfs_mount_t* best = NULL;
+
+	while(*p == '/') {
+		p++;
+	}
+
+	for(i=0;i<VFS_MAX_MOUNTS;i++) {
+		len = vfs_mounts[i].path_len;
+		if(!vfs_mounts[i].ops || (best && best->path_len >= len)) {
+			continue;
+		}
+		if(len == 0 || (strncmp((int8_t*)p, (int8_t*)vfs_mounts[i].path, len) == 0 && (p[len] == '\0' || p[len] == '/'))) {
+			best = &vfs_mounts[i];
+		}
+	}
+
+	if(!best) {
+		return NULL;
+	}
+
+	// the root file system resolves "/" and "." itself
+	if(best->path_len == 0) {
+		*rest = path;
+		return best;
+	}
+
+	p += best->path_len;
+	while(*p == '/') {
+		p++;
+	}
+	*rest = p;
+	return best;
+}
+
+/*	vfs_lookup
+ *   DESCRIPTION: this function finds the vnode of a path. the vnode of a file that
+ *				  is already open is shared, otherwise a new one is filled in by
+ *				  the file system mounted there
+ *   INPUTS: path -- the path
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the vnode with a reference taken, NULL if the path does not
+ *				   exist or no memory is left for a vnode
+ *   SIDE EFFECTS: vnode list updated
+ */
+vnode_t* vfs_lookup(const uint8_t* path) {
+	uint32_t ino, type;
+	uint32_t flags;
+	const uint8_t* rest;
+	vfs_mount_t* mnt;
+	vnode_t* vnode;
+
+	if(!path) {
+		return NULL;
+	}
+
+	mnt = vfs_find_mount(path, &rest);
+	if(!mnt || mnt->ops->lookup(rest, &ino, &type) == -1) {
+		return NULL;	// no such file
+	}
+
+	cli_and_save(flags);
+	for(vnode = vnode_list; vnode; vnode = vnode->next) {
+		if(vnode->mnt == mnt && vnode->ino == ino && vnode->type == type) {
+			vnode->refcount++;	// already open
+			restore_flags(flags);
+			return vnode;
+		}
+	}
+
+	vnode = kmem_cache_alloc(&vnode_cache);
+	if(!vnode) {
+		restore_flags(flags);
+		return NULL;	// out of memory
+	}
+
+	memset(vnode, 0, sizeof(vnode_t));
+	vnode->refcount = 1;
+	vnode->mnt = mnt;
+	vnode->ino = ino;
+	vnode->type = type;
+	if(mnt->ops->fill(vnode) == -1) {
+		kmem_cache_free(&vnode_cache, vnode);
+		vnode = NULL;
+	}
+	else {
+		vnode->next = vnode_list;
+		vnode_list = vnode;
+	}
+	restore_flags(flags);
+
+	return vnode;
+}
+
+/*	vfs_put
+ *   DESCRIPTION: this function drops a reference to a vnode, the last one frees it
+ *				  and lets the file system release what it kept for the file
+ *   INPUTS: vnode -- the vnode
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: NONE
+ *   SIDE EFFECTS: vnode list updated
+ */
+void vfs_put(vnode_t* vnode) {
+	uint32_t flags;
+	vnode_t** link;
+
+	if(!vnode) {
+		return;
+	}
+
+	cli_and_save(flags);
+	if(!vnode->refcount || --vnode->refcount) {
+		restore_flags(flags);
+		return;
+	}
+
+	if(vnode->mnt && vnode->mnt->ops->release) {
+		vnode->mnt->ops->release(vnode);
+	}
+	for(link = &vnode_list; *link; link = &(*link)->next) {
+		if(*link == vnode) {
+			*link = vnode->next;
+			break;
+		}
+	}
+	kmem_cache_free(&vnode_cache, vnode);
+	restore_flags(flags);
+}
+
+/*	vfs_open
+ *   DESCRIPTION: this function opens a path into a file descriptor. the path is
+ *				  looked up once here, reads and writes then go straight to the
+ *				  operations of the vnode
+ *   INPUTS: file_desc -- the unused file descriptor to fill in
+ *			 path -- the path
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the path does not exist or the device
+ *				   cannot be opened
+ *   SIDE EFFECTS: file_desc modified, a vnode reference taken
+ */
+int32_t vfs_open(fd_t* file_desc, const uint8_t* path) {
+	vnode_t* vnode;
+
+	if(!file_desc) {
+		return -1;
+	}
+
+	vnode = vfs_lookup(path);
+	if(!vnode) {
+		return -1;
+	}
+
+	file_desc->vnode = vnode;
+	file_desc->fops_p = vnode->fops;
+	file_desc->file_pos = 0;
+	file_desc->flags = 1;
+	file_desc->ra_pos = 0;
+	file_desc->ra_window = 0;
+	file_desc->ra_end = 0;
+
+	if(vnode->open && vnode->open(file_desc) == -1) {
+		file_desc->vnode = NULL;
+		file_desc->fops_p = NULL;
+		file_desc->flags = 0;
+		vfs_put(vnode);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*	vfs_close
+ *   DESCRIPTION: this function closes a file descriptor through its close operation
+ *				  and drops the reference to its vnode
+ *   INPUTS: file_desc -- the open file descriptor
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: what the close operation returns, -1 if not open
+ *   SIDE EFFECTS: file_desc cleared, a vnode reference dropped
+ */
+int32_t vfs_close(fd_t* file_desc) {
+	vnode_t* vnode;
+	int32_t ret;
+
+	if(!file_desc || !file_desc->flags || !file_desc->fops_p) {
+		return -1;
+	}
+
+	vnode = file_desc->vnode;
+	ret = file_desc->fops_p->close(file_desc);
+	file_desc->vnode = NULL;
+	file_desc->fops_p = NULL;
+	file_desc->flags = 0;
+	vfs_put(vnode);
+
+	return ret;
+}
+
+/*	vfs_create
+ *   DESCRIPTION: this function creates an empty regular file through the file
+ *				  system the path is under
+ *   INPUTS: path -- the path of the new file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the file system cannot create it
+ *   SIDE EFFECTS: NONE
+ */
+int32_t vfs_create(const uint8_t* path) {
+	const uint8_t* rest;
+	vfs_mount_t* mnt;
+
+	if(!path) {
+		return -1;
+	}
+
+	mnt = vfs_find_mount(path, &rest);
+	if(!mnt || !mnt->ops->create) {
+		return -1;	// nothing mounted or read only file system
+	}
+
+	// the root file system gets the whole path, but a new file is named without the '/'
+	while(*rest == '/') {
+		rest++;
+	}
+
+	return mnt->ops->create(rest);
+}
+
+/*	vfs_unlink
+ *   DESCRIPTION: this function removes the name of a file through the file system
+ *				  the path is under. files still open keep their data until closed
+ *   INPUTS: path -- the path of the file
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: 0 on success, -1 if the file system cannot remove it
+ *   SIDE EFFECTS: NONE
+ */
+int32_t vfs_unlink(const uint8_t* path) {
+	const uint8_t* rest;
+	vfs_mount_t* mnt;
+
+	if(!path) {
+		return -1;
+	}
+
+	mnt = vfs_find_mount(path, &rest);
+	if(!mnt || !mnt->ops->unlink) {
+		return -1;	// nothing mounted or no unlink there
+	}
+
+	return mnt->ops->unlink(rest);
+}
+
+/*	vfs_lseek
+ *   DESCRIPTION: this function moves the file position of an open regular file.
+ *				  seeking past the end of file is allowed, reads there return 0
+ *   INPUTS: file_desc -- file descriptor of the file
+ *			 offset -- offset relative to whence
+ *			 whence -- SEEK_SET, SEEK_CUR or SEEK_END
+ *   OUTPUTS: NONE
+ *   RETURN VALUE: the new file position, -1 on failure
+ *   SIDE EFFECTS: file position updated
+ */
+int32_t vfs_lseek(fd_t* file_desc, int32_t offset, int32_t whence) {
+
+	int32_t base;
+
+	if(!file_desc || file_desc->flags != 1 || !file_desc->vnode || file_desc->vnode->type != REG_FILE) {
+		return -1;	// file not in use or not a regular file
+	}
+
+	switch(whence) {
+		case SEEK_SET:
+			base = 0;
+			break;
+		case SEEK_CUR:
+			base = file_desc->file_pos;
+			break;
+		case SEEK_END:
+			base = file_desc->vnode->length;
+			break;
+		default:
+			return -1;	// invalid whence
+	}
+
+	if(offset < 0 && base + offset < 0) {
+		return -1;	// before the start of file
+	}
+
+	file_desc->file_pos = base + offset;
+	return file_desc->file_pos;
+}
@@ -0,0 +1,79 @@
+#ifndef _VFS_H
+#define _VFS_H
+
+#include "types.h"
+#include "lib.h"
+#include "slab.h"
+
+#define VFS_MAX_MOUNTS 4
+#define VFS_PATH_SIZE 16			// longest mount point, null terminated
+#define VFS_ROOT_INO 0xFFFFFFFF		// inode number of a directory that has no index node
+
+#define VN_XLATE_SIZE 16	// block numbers cached per vnode
+
+struct vnode;
+
+/* block translation cache of a regular file, file blocks first up to first+count-1
+ * are in data blocks block[], valid while gen matches fs_map_gen */
+typedef struct xlate
+{
+	uint32_t gen;
+	uint32_t first;
+	uint32_t count;
+	uint32_t block[VN_XLATE_SIZE];
+} xlate_t;
+
+/* what a mounted file system provides. lookup resolves a path below the mount
+ * point to an inode number and type, fill sets up a new vnode for them. create
+ * and unlink are NULL if the file system has no such operation, release is
+ * called when the last reference to a vnode is dropped and may be NULL */
+typedef struct vfs_ops
+{
+	int32_t (*lookup)(const uint8_t* path, uint32_t* ino, uint32_t* type);
+	int32_t (*fill)(struct vnode* vnode);
+	int32_t (*create)(const uint8_t* path);
+	int32_t (*unlink)(const uint8_t* path);
+	void (*release)(struct vnode* vnode);
+} vfs_ops_t;
+
+typedef struct vfs_mount
+{
+	uint8_t path[VFS_PATH_SIZE];	// mount point without the leading '/', "" for the root
+	uint32_t path_len;
+	vfs_ops_t* ops;					// NULL if the slot is unused
+} vfs_mount_t;
+
+/* an in-memory inode, looked up once at open and shared by every file descriptor
+ * open on the same file. it lives while a descriptor holds a reference */
+typedef struct vnode
+{
+	uint32_t refcount;		// open file descriptors, 0 if the slot is free
+	vfs_mount_t* mnt;		// NULL once the file system was mounted again
+	uint32_t ino;			// inode number within the mount
+	uint32_t type;			// one of the xxx_FILE types
+	uint32_t length;		// file length in bytes, kept up to date by writes
+	uint32_t* node;			// index node of the file, NULL if it has none
+	fops_table_t* fops;		// read, write and close of the open files
+	int32_t (*open)(fd_t* file_desc);	// device setup at every open, or NULL
+	xlate_t xlate;			// shared by every open file
+	struct vnode* next;		// next open vnode
+} vnode_t;
+
+/*mounts a file system at a path, replacing what was mounted there*/
+extern vfs_mount_t* vfs_mount(const uint8_t* path, vfs_ops_t* ops);
+/*finds the vnode of a path and takes a reference to it*/
+extern vnode_t* vfs_lookup(const uint8_t* path);
+/*drops a reference to a vnode*/
+extern void vfs_put(vnode_t* vnode);
+/*opens a path into a file descriptor*/
+extern int32_t vfs_open(fd_t* file_desc, const uint8_t* path);
+/*closes a file descriptor and drops its vnode*/
+extern int32_t vfs_close(fd_t* file_desc);
+/*creates an empty regular file*/
+extern int32_t vfs_create(const uint8_t* path);
+/*removes a file, its data goes away once it is closed everywhere*/
+extern int32_t vfs_unlink(const uint8_t* path);
+/*moves the file position of an open regular file*/
+extern int32_t vfs_lseek(fd_t* file_desc, int32_t offset, int32_t whence);
+
+#endif
@@ -40,6 +40,7 @@ extern void handle_rtc();
 extern void handle_keyboard();
 extern void handle_pit();
 extern void handle_mouse();
+extern void handle_ata();
 #endif
 #endif
 
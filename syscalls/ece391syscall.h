@@ -22,6 +22,62 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/* one directory entry as filled in by ece391_readdir */
+typedef struct ece391_dirent {
+	uint8_t name[32];	/* file name, zero padded */
+	uint32_t name_len;	/* number of valid bytes in name */
+	uint32_t type;		/* 0 rtc file, 1 directory, 2 regular file */
+	uint32_t inode;		/* index node number for the file */
+	uint32_t length;	/* file length in bytes, 0 if not a regular file */
+} ece391_dirent_t;
+
+extern int32_t ece391_readdir (int32_t fd, ece391_dirent_t* entries, int32_t count);
+
+/* file information as filled in by ece391_fstat */
+typedef struct ece391_stat {
+	uint32_t type;		/* 0 rtc file, 1 directory, 2 regular file, 3 terminal, 4 mouse */
+	uint32_t inode;		/* index node number, 0 if the file has none */
+	uint32_t length;	/* file length in bytes, number of entries for a directory */
+	uint32_t file_pos;	/* current read position */
+} ece391_stat_t;
+
+/* whence values for ece391_lseek */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+extern int32_t ece391_fstat (int32_t fd, ece391_stat_t* buf);
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+extern int32_t ece391_mmap (int32_t fd, uint8_t** addr);
+extern int32_t ece391_create (const uint8_t* filename);
+extern int32_t ece391_truncate (int32_t fd, uint32_t length);
+extern int32_t ece391_sync (void);
+
+/* block cache counters as filled in by ece391_cachestat */
+typedef struct ece391_cachestat {
+	uint32_t hits;		/* block accesses served by the cache */
+	uint32_t misses;	/* blocks read from the device into the cache */
+	uint32_t direct;	/* block accesses served straight from the memory resident image */
+	uint32_t evictions;	/* cached blocks dropped to make room */
+	uint32_t writebacks;	/* dirty blocks written to the device */
+	uint32_t readahead;	/* blocks requested ahead of a sequential reader */
+	uint32_t dev_reads;	/* block reads done by the device */
+	uint32_t dev_writes;	/* block writes done by the device */
+} ece391_cachestat_t;
+
+extern int32_t ece391_cachestat (ece391_cachestat_t* buf);
+extern int32_t ece391_unlink (const uint8_t* filename);
+
+/* paging counters as filled in by ece391_vmstat */
+typedef struct ece391_vmstat {
+	uint32_t cr3_reloads;		/* page directory loads since boot */
+	uint32_t cr3_reloads_per_sec;	/* page directory loads in the last whole second */
+	uint32_t frames_free;		/* 4kB frames not allocated */
+} ece391_vmstat_t;
+
+extern int32_t ece391_vmstat (ece391_vmstat_t* buf);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
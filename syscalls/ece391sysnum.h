@@ -11,5 +11,16 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_READDIR 11
+#define SYS_FSTAT   12
+#define SYS_LSEEK   13
+#define SYS_PREAD   14
+#define SYS_MMAP    15
+#define SYS_CREATE  16
+#define SYS_TRUNCATE 17
+#define SYS_SYNC    18
+#define SYS_CACHESTAT 19
+#define SYS_UNLINK  20
+#define SYS_VMSTAT  21
 
 #endif /* ECE391SYSNUM_H */